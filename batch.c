@@ -0,0 +1,158 @@
+    // Batch evaluator: runs keystroke scripts through the calculator logic
+    //  of main.c on the host, with no keypad, display or timing involved.
+    //
+    //  Build:  cc -DHOST_SIM -O2 -o batch
+    //              batch.c host_sim.c main.c sched.c serial.c
+    //              clock.c persist.c trace.c
+    //  Usage:  batch [script_file ...]    (reads stdin without a file)
+    //
+    // A script is one line of key names, the same names as in simulator
+    //  traces (see sim_key_bits() in host_sim.h): digits and operator
+    //  glyphs, E Enter, D Delete, F the second function prefix, B
+    //  brightness, S the counters, Q and T the termination chords. Blanks
+    //  are ignored and '#' comments out the rest of the line.
+    //
+    // Every script starts from the power-on state, and so does the rest
+    //  of a script after Q or T: the statistics and the counters are
+    //  cleared too, so nothing carries over from one script to the next.
+    //  For each input line one output line is written, holding the
+    //  display as it stands after each Enter:
+    //
+    //      12+34E          -->  [ 46.  ]
+    //      9999*9999EE     -->  [ 999.8] [ 0001.]
+    //      5F0E            -->  [ 1.   ]
+    //      F7E             -->  [ E   ]
+    //
+    //  A leading '-' is the sign indicator, '.' follows a lit dot; on a
+    //  wide result the dots count the page. Pages are stepped with further
+    //  Enters only, as the timed paging of the firmware does not apply.
+    //  Input and output are streamed through fixed buffers, so corpora of
+    //  any size run in constant memory.
+
+#include "hal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define IN_BUF      65536u
+#define OUT_BUF     65536u
+    // Room needed in the output buffer for one display and a newline
+#define DISP_TEXT   16u
+
+    // From main.c
+uint8_t press_key(uint8_t row, uint8_t col);
+char* text_display(char* at);
+void reset_unit(void);
+
+    // Key name --> row << 4 | column bits, 0 for anything that is not a key
+static uint8_t key_code[256];
+
+static char out_buf[OUT_BUF];
+static size_t out_len;
+
+static void flush_out(void){
+    if(out_len && fwrite(out_buf, 1, out_len, stdout) != out_len){
+        perror("batch");
+        exit(2);
+    }
+    out_len = 0;
+}
+
+static void make_key_codes(void){
+    unsigned name = 1;
+    for(; name < 256; ++name){
+        uint16_t bits = sim_key_bits((char)name);
+        uint8_t row = 0;
+        if(!bits)   continue;
+        while(!((bits >> (row * 4u)) & KEY_COL_ALL))  ++row;
+        key_code[name] = row << 4 | ((bits >> (row * 4u)) & KEY_COL_ALL);
+    }
+}
+
+static void put_display(int first){
+    char* text = NULL;
+    if(out_len + DISP_TEXT > OUT_BUF)   flush_out();
+    text = out_buf + out_len;
+    if(!first)  *text++ = ' ';
+        // The same text as the serial port's d reply
+    out_len = text_display(text) - out_buf;
+}
+
+static void put_newline(void){
+    if(out_len == OUT_BUF)  flush_out();
+    out_buf[out_len++] = '\n';
+}
+
+    // Run every script in src. Returns 0, or 1 after reporting a bad key.
+static int run_stream(FILE* src, const char* name){
+    static char in_buf[IN_BUF];
+    unsigned long line = 1;
+    int comment = 0, shown = 0, dirty = 0, partial = 0;
+    size_t got = 0, n = 0;
+
+    reset_unit();
+    while((got = fread(in_buf, 1, IN_BUF, src)) > 0){
+        for(n = 0; n < got; ++n){
+            unsigned char c = (unsigned char)in_buf[n];
+            if(c == '\n'){
+                put_newline();
+                if(dirty)   reset_unit();
+                ++line;
+                comment = shown = dirty = partial = 0;
+                continue;
+            }
+            partial = 1;
+            if(comment || c == ' ' || c == '\t' || c == '\r')   continue;
+            if(c == '#'){
+                comment = 1;
+                continue;
+            }
+            if(!key_code[c]){
+                flush_out();
+                fprintf(stderr,
+                    "batch: %s:%lu: unknown key '%c'\n", name, line, c
+                );
+                return 1;
+            }
+
+            dirty = 1;
+            if(!press_key(key_code[c] >> 4, key_code[c] & KEY_COL_ALL)){
+                reset_unit();
+                continue;
+            }
+            if(c == 'E'){
+                put_display(!shown);
+                shown = 1;
+            }
+        }
+    }
+        // A last line without its newline still gets its output line
+    if(partial) put_newline();
+    if(ferror(src)){
+        perror(name);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]){
+    int arg = 1, failed = 0;
+    make_key_codes();
+
+    if(argc < 2){
+        failed = run_stream(stdin, "<stdin>");
+    }
+    for(; arg < argc && !failed; ++arg){
+        FILE* src = fopen(argv[arg], "rb");
+        if(src == NULL){
+            perror(argv[arg]);
+            failed = 1;
+            break;
+        }
+        failed = run_stream(src, argv[arg]);
+        fclose(src);
+    }
+
+    flush_out();
+    return failed;
+}
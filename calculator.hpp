@@ -0,0 +1,563 @@
+#ifndef CALCULATOR_HPP
+#define CALCULATOR_HPP
+
+    // Header-only calculator engine. The entry and arithmetic of main.c,
+    //  with the digit count, precision and radix as template parameters
+    //  instead of macros and one global calculator_information_packet, so
+    //  any number of configurations can live in one build.
+    //
+    //  - Every state transition is constexpr. The checks at the end of this
+    //    file run the engine on key sequences as static_asserts.
+    //  - Loops over the digits of an operand are unrolled at compile time
+    //    through index sequences. Loops whose trip count depends on the
+    //    value (result digits, the division kernels) stay loops.
+    //  - The multiply and divide kernels are the ones main.c uses on the
+    //    M0+, and the radix conversion is picked at compile time.
+    //
+    // Needs C++17. For the same keys, results, pages and the display match
+    //  main.c in the same radix. Radix cycling and timed paging are left to
+    //  the caller, as are the keypad and display themselves.
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace calc{
+
+    // Operator glyphs, as in main.c
+constexpr char add_glyph = '+';
+constexpr char sub_glyph = '-';
+constexpr char mul_glyph = '*';
+constexpr char div_glyph = '/';
+constexpr char and_glyph = '&';
+constexpr char or_glyph  = '|';
+constexpr char xor_glyph = '^';
+constexpr char shl_glyph = '<';
+constexpr char shr_glyph = '>';
+
+    // Digit codes that are not digits, as in main.c
+constexpr std::uint8_t null_dig = 255u;
+constexpr std::uint8_t blank_dig = 254u;
+constexpr std::uint8_t error_dig = 0xEu;
+
+    // Largest result magnitude
+constexpr std::uint64_t wide_max = 0x7FFFFFFFFFFFFFFFull;
+
+enum class state : std::uint8_t{
+    number,     // Taking digits
+    op,         // Operand full, waiting for an operator
+    finished    // Showing a result
+};
+
+namespace detail{
+        // f(0), f(1) ... f(N-1), each with a constant argument
+    template <typename F, std::size_t... I>
+    constexpr void unroll(F&& f, std::index_sequence<I...>){
+        (f(I), ...);
+    }
+    template <std::size_t N, typename F>
+    constexpr void unroll(F&& f){
+        unroll(f, std::make_index_sequence<N>{});
+    }
+
+        // Bits of the radix when it is a power of two, 0 otherwise
+    constexpr unsigned radix_shift(unsigned radix){
+        return radix == 2u ? 1u : radix == 8u ? 3u : radix == 16u ? 4u : 0u;
+    }
+        // Digits needed for wide_max
+    constexpr unsigned wide_digits(unsigned radix){
+        unsigned count = 0u;
+        for(std::uint64_t left = wide_max; left; left /= radix)  ++count;
+        return count;
+    }
+        // Whether an operand of digits digits fits 32 bits
+    constexpr bool fits_32(unsigned radix, unsigned digits){
+        std::uint64_t limit = 1u;
+        for(; digits; --digits) limit *= radix;
+        return limit <= 0x100000000ull;
+    }
+
+        // Kernels, as in main.c
+    constexpr std::uint32_t divu10(std::uint32_t n){
+        std::uint32_t q = (n >> 1) + (n >> 2);
+        q += q >> 4;
+        q += q >> 8;
+        q += q >> 16;
+        q >>= 3;
+        std::uint32_t r = n - ((q << 3) + (q << 1));
+        return q + ((r + 6u) >> 4);
+    }
+    constexpr std::uint64_t mul32x32(std::uint32_t a, std::uint32_t b){
+        std::uint32_t a_lo = a & 0xFFFFu, a_hi = a >> 16;
+        std::uint32_t b_lo = b & 0xFFFFu, b_hi = b >> 16;
+        std::uint32_t lo = a_lo * b_lo, hi = a_hi * b_hi;
+        std::uint32_t mid = a_lo * b_hi, cross = a_hi * b_lo;
+        mid += cross;
+        if(mid < cross) hi += 0x10000u;
+        cross = mid << 16;
+        lo += cross;
+        if(lo < cross)  ++hi;
+        hi += mid >> 16;
+        return (static_cast<std::uint64_t>(hi) << 32) | lo;
+    }
+    constexpr std::uint64_t mul_wide(
+        std::uint64_t a, std::uint32_t b, bool& over
+    ){
+        std::uint64_t lo = mul32x32(static_cast<std::uint32_t>(a), b);
+        std::uint64_t hi = mul32x32(static_cast<std::uint32_t>(a >> 32), b);
+        over = (hi >> 32) != 0u;
+        hi <<= 32;
+        lo += hi;
+        if(lo < hi) over = true;
+        return lo;
+    }
+    constexpr std::uint32_t div64x32(
+        std::uint32_t hi, std::uint32_t lo, std::uint32_t d, std::uint32_t& rem
+    ){
+        unsigned counter = 32u;
+        std::uint32_t carry = 0u;
+        for(; counter > 0u && !hi && !(lo >> 24); counter -= 8u) lo <<= 8;
+        for(; counter > 0u; --counter){
+            carry = hi >> 31;
+            hi = (hi << 1) | (lo >> 31);
+            lo <<= 1;
+            if(carry || hi >= d){
+                hi -= d;
+                lo |= 0x1u;
+            }
+        }
+        rem = hi;
+        return lo;
+    }
+    constexpr std::uint32_t div_wide(std::uint64_t& n, std::uint32_t d){
+        std::uint32_t hi = static_cast<std::uint32_t>(n >> 32), rem = hi;
+        std::uint32_t quot = 0u;
+        if(hi >= d) quot = div64x32(0u, hi, d, rem);
+        n = (static_cast<std::uint64_t>(quot) << 32)
+            | div64x32(rem, static_cast<std::uint32_t>(n), d, rem);
+        return rem;
+    }
+
+        // compute_wide() in main.c
+    constexpr std::int64_t apply(
+        char op_code, std::int64_t op1, std::int64_t op2, bool& over
+    ){
+        bool neg1 = op1 < 0, neg2 = op2 < 0;
+        std::uint64_t mag1 = neg1 ? 0u - static_cast<std::uint64_t>(op1)
+            : static_cast<std::uint64_t>(op1);
+        std::uint64_t mag2 = neg2 ? 0u - static_cast<std::uint64_t>(op2)
+            : static_cast<std::uint64_t>(op2);
+        std::uint64_t mag = 0u;
+        std::int64_t res = 0;
+        over = false;
+
+        switch(op_code){
+            case add_glyph:
+                res = static_cast<std::int64_t>(
+                    static_cast<std::uint64_t>(op1)
+                    + static_cast<std::uint64_t>(op2)
+                    );
+                over = ((op1 ^ res) & (op2 ^ res)) < 0;
+                break;
+            case sub_glyph:
+                res = static_cast<std::int64_t>(
+                    static_cast<std::uint64_t>(op1)
+                    - static_cast<std::uint64_t>(op2)
+                    );
+                over = ((op1 ^ op2) & (op1 ^ res)) < 0;
+                break;
+            case mul_glyph:
+                if(mag2 >> 32){
+                    mag = mag1;
+                    mag1 = mag2;
+                    mag2 = mag;
+                }
+                if(mag2 >> 32){
+                    over = mag1 != 0u;
+                    mag = 0u;
+                } else {
+                    mag = mul_wide(
+                        mag1, static_cast<std::uint32_t>(mag2), over
+                        );
+                }
+                res = neg1 != neg2
+                    ? -static_cast<std::int64_t>(mag & wide_max)
+                    : static_cast<std::int64_t>(mag & wide_max);
+                over |= mag > wide_max;
+                return res;
+            case div_glyph:
+                if(mag2 == 0u){
+                    over = true;
+                    return 0;
+                }
+                if(mag2 >> 32){
+                    unsigned counter = 64u;
+                    for(mag = 0u; counter > 0u; --counter){
+                        mag = (mag << 1) | (mag1 >> 63);
+                        mag1 <<= 1;
+                        if(mag >= mag2){
+                            mag -= mag2;
+                            mag1 |= 0x1u;
+                        }
+                    }
+                } else {
+                    div_wide(mag1, static_cast<std::uint32_t>(mag2));
+                }
+                return neg1 != neg2 ? -static_cast<std::int64_t>(mag1)
+                    : static_cast<std::int64_t>(mag1);
+            case and_glyph: res = op1 & op2;    break;
+            case or_glyph:  res = op1 | op2;    break;
+            case xor_glyph: res = op1 ^ op2;    break;
+            case shl_glyph:
+                if(neg2 || mag2 > 62u || mag1 > (wide_max >> mag2)){
+                    over = mag1 != 0u;
+                    return 0;
+                }
+                mag = mag1 << mag2;
+                return neg1 ? -static_cast<std::int64_t>(mag)
+                    : static_cast<std::int64_t>(mag);
+            case shr_glyph:
+                if(neg2 || mag2 > 62u)  res = neg1 ? -1 : 0;
+                else                    res = op1 >> mag2;
+                break;
+            default:
+                return op1;
+        }
+        over |= res < -static_cast<std::int64_t>(wide_max);
+        return res;
+    }
+}
+
+    // Digits per operand, how many of them are after the point, and the
+    //  radix of entry and display: 2, 8, 10 or 16.
+template <unsigned Digits, unsigned Precision = 0u, unsigned Radix = 10u>
+class Calculator{
+    static_assert(
+        Radix == 2u || Radix == 8u || Radix == 10u || Radix == 16u,
+        "the radix is one of 2, 8, 10 and 16"
+        );
+    static_assert(Digits > 0u && Precision < Digits, "no digits to enter");
+    static_assert(
+        detail::fits_32(Radix, Digits), "operands are joined in 32 bits"
+        );
+
+public:
+    static constexpr unsigned digits = Digits;
+    static constexpr unsigned magnitude = Digits - Precision;
+    static constexpr unsigned radix = Radix;
+    static constexpr unsigned radix_shift = detail::radix_shift(Radix);
+    static constexpr unsigned result_digits = detail::wide_digits(Radix);
+
+    constexpr Calculator(){
+        reset();
+    }
+
+        // Back to power on: reset_info_pack()
+    constexpr void reset(){
+        detail::unroll<Digits*2u>([&](std::size_t n){
+            operand_[n] = null_dig;
+        });
+        index_ = op_code_ = is_neg_ = 0u;
+        magnitude_ = shown_ = 0u;
+        state_ = state::number;
+        result_ = 0u;
+        result_len_ = page_ = 0u;
+        op1_is_result_ = error_ = false;
+    }
+
+        // Keys. Each returns whether the key was taken, as the store_*
+        //  functions do.
+    constexpr bool digit(std::uint8_t new_dig){
+        switch(state_){
+            case state::finished:
+                reset();
+                [[fallthrough]];
+            case state::number:
+                if(new_dig >= Radix || magnitude_ == magnitude)
+                    return false;
+                if(!(magnitude_ || new_dig))    return true;
+                operand_[index_] = new_dig;
+                if(index_ < Digits) op1_is_result_ = false;
+                ++magnitude_;
+                ++index_;
+                if(index_ > Digits) shown_ = 1u;
+                if(magnitude_ == magnitude){
+                    magnitude_ = 0u;
+                    state_ = state::op;
+                }
+                return true;
+            default:
+                return false;
+        }
+    }
+    constexpr bool op(char new_op){
+        switch(state_){
+            case state::op:
+                    // A full second operand leaves no room for a third
+                if(index_ > Digits) return false;
+                op_code_ = new_op;
+                state_ = state::number;
+                shown_ = 1u;
+                return true;
+            case state::number:
+                if(index_ >= Digits)    return false;
+                [[fallthrough]];
+            case state::finished:
+                if(error_)  return false;
+                state_ = state::number;
+                op_code_ = new_op;
+                index_ = Digits;
+                magnitude_ = 0u;
+                shown_ = 1u;
+                return true;
+            default:
+                return false;
+        }
+    }
+    constexpr void del(){
+        if(index_ == 0u){
+            operand_[0] = null_dig;
+            is_neg_ = 0u;
+            magnitude_ = 0u;
+            error_ = false;
+            return;
+        }
+        if(index_ == Digits){
+            if(state_ == state::op){
+                operand_[Digits - 1u] = null_dig;
+                state_ = state::number;
+            } else {
+                state_ = state::op;
+            }
+            magnitude_ = Digits;
+            for(
+                unsigned counter = Digits;
+                counter > 0u && operand_[counter - 1u] == null_dig;
+                --counter
+            )   --magnitude_;
+            index_ = magnitude_;
+            shown_ = 0u;
+            return;
+        }
+        --index_;
+        operand_[index_] = null_dig;
+        if(index_ < Digits) op1_is_result_ = false;
+        state_ = state::number;
+            // A full operand has already wrapped its magnitude to 0
+        magnitude_ = index_ % Digits;
+    }
+        // Compute, or step a wide result to its next page
+    constexpr void enter(){
+        if(state_ == state::finished){
+            if(result_len_ > Digits)    next_page();
+            return;
+        }
+        if(index_ < Digits) return;
+        page_ = 0u;
+        if(compute()){
+            reset();
+            error_ = true;
+        } else if(result_len_ > Digits){
+            next_page();
+        }
+        state_ = state::finished;
+        shown_ = 0u;
+    }
+    constexpr void next_page(){
+        page_ = page_ ? page_ - 1u : (result_len_ - 1u) / Digits;
+    }
+
+        // What digit select (0 the rightmost) shows: a digit, or null_dig
+        //  or blank_dig when dark, and whether its dot is lit.
+    constexpr std::uint8_t shown_dig(unsigned select, bool& dot) const{
+        dot = false;
+        if(error_)  return select == Digits - 1u ? error_dig : null_dig;
+        if(state_ == state::finished && result_len_ > Digits){
+            unsigned pos = page_*Digits + select;
+            dot = ((page_ + 1u) >> select) & 0x1u;
+            return pos < result_len_ ? result_dig_[pos] : blank_dig;
+        }
+        std::uint8_t dig = operand_[shown_*Digits + Digits - 1u - select];
+        dot = dig != null_dig && select ==
+            Digits - 1u - ((index_ - 1u) % Digits) + Precision;
+        return dig;
+    }
+    constexpr bool shown_sign() const{
+        return (is_neg_ >> shown_) & 0x1u;
+    }
+
+    constexpr calc::state entry_state() const{  return state_; }
+    constexpr bool error() const{               return error_; }
+    constexpr std::uint8_t page() const{        return page_; }
+        // Last result: magnitude, sign and digits, least significant first
+    constexpr std::uint64_t result() const{     return result_; }
+    constexpr bool negative() const{            return is_neg_ & 0x1u; }
+    constexpr std::uint8_t result_len() const{  return result_len_; }
+    constexpr std::uint8_t result_dig(unsigned n) const{
+        return result_dig_[n];
+    }
+        // Operand slots, big endian: operand 1, then operand 2
+    constexpr std::uint8_t operand(unsigned n) const{ return operand_[n]; }
+
+private:
+        // join_digits(): stops at the first empty slot
+    constexpr std::uint32_t join(unsigned first) const{
+        std::uint32_t value = 0u;
+        bool live = true;
+        detail::unroll<Digits>([&](std::size_t n){
+            live = live && operand_[first + n] != null_dig;
+            if(live)    value = value*Radix + operand_[first + n];
+        });
+        return value;
+    }
+
+        // compute(). Returns whether it overloaded, leaving the state alone.
+    constexpr bool compute(){
+        std::int64_t op1 = 0, op2 = 0;
+        bool over = false;
+        if(op_code_ == 0u)  return false;
+        op1 = op1_is_result_ ? static_cast<std::int64_t>(result_) : join(0u);
+        op2 = join(Digits);
+        if(is_neg_ & 0x1u)  op1 = -op1;
+        if(is_neg_ & 0x2u)  op2 = -op2;
+
+        op1 = detail::apply(op_code_, op1, op2, over);
+        if(over)    return true;
+
+        if(op1 < 0){
+            is_neg_ |= 0x1u;
+            op1 = -op1;
+        } else {
+            is_neg_ = 0u;
+        }
+        detail::unroll<Digits>([&](std::size_t n){
+            operand_[Digits + n] = null_dig;
+        });
+        magnitude_ = index_ = store_result(static_cast<std::uint64_t>(op1));
+        op_code_ = 0u;
+        is_neg_ &= ~0x2u;
+        return false;
+    }
+
+        // store_result(): returns the digits put in operand 1
+    constexpr std::uint8_t store_result(std::uint64_t value){
+        result_ = value;
+        op1_is_result_ = true;
+        result_len_ = 0u;
+        if constexpr(radix_shift != 0u){
+            for(; value; value >>= radix_shift){
+                result_dig_[result_len_++] =
+                    static_cast<std::uint8_t>(value & (Radix - 1u));
+            }
+        } else {
+                // Nine digits at a time, with one wide division each
+            while(value){
+                std::uint32_t chunk = 0u;
+                if(value >= 1000000000u){
+                    chunk = detail::div_wide(value, 1000000000u);
+                } else {
+                    chunk = static_cast<std::uint32_t>(value);
+                    value = 0u;
+                }
+                for(unsigned n = 9u; n > 0u && (chunk || value); --n){
+                    std::uint32_t quot = detail::divu10(chunk);
+                    result_dig_[result_len_++] =
+                        static_cast<std::uint8_t>(chunk - quot*10u);
+                    chunk = quot;
+                }
+            }
+        }
+        std::uint8_t used = result_len_ < Digits ? result_len_ : Digits;
+        detail::unroll<Digits>([&](std::size_t n){
+            operand_[n] = n < used ? result_dig_[used - 1u - n] : null_dig;
+        });
+        return used;
+    }
+
+    std::uint8_t operand_[Digits*2u] = {};
+    std::uint8_t index_ = 0u, op_code_ = 0u, is_neg_ = 0u;
+    std::uint8_t magnitude_ = 0u, shown_ = 0u;
+    calc::state state_ = state::number;
+    std::uint64_t result_ = 0u;
+    std::uint8_t result_dig_[result_digits] = {};
+    std::uint8_t result_len_ = 0u, page_ = 0u;
+    bool op1_is_result_ = false, error_ = false;
+};
+
+    // Run a key sequence from power on. Keys are named as in batch
+    //  scripts: digits, with a - f for the hex digits, the operator
+    //  glyphs, E for Enter and D for Delete.
+template <typename C>
+constexpr C run(const char* keys){
+    C c{};
+    for(; *keys; ++keys){
+        if(*keys >= '0' && *keys <= '9')
+            c.digit(static_cast<std::uint8_t>(*keys - '0'));
+        else if(*keys >= 'a' && *keys <= 'f')
+            c.digit(static_cast<std::uint8_t>(*keys - 'a' + 10));
+        else if(*keys == 'E')
+            c.enter();
+        else if(*keys == 'D')
+            c.del();
+        else
+            c.op(*keys);
+    }
+    return c;
+}
+
+    // Whether the display reads text: one character per digit, most
+    //  significant first, ' ' for a dark digit. Dots are not compared.
+template <typename C>
+constexpr bool shows(const C& c, const char* text){
+    static_assert(C::radix <= 16u, "one character per digit");
+    constexpr char glyphs[] = "0123456789ABCDEF";
+    for(unsigned select = C::digits; select > 0u; --select, ++text){
+        bool dot = false;
+        std::uint8_t dig = c.shown_dig(select - 1u, dot);
+        if(*text != (dig < 16u ? glyphs[dig] : ' '))  return false;
+    }
+    return *text == '\0';
+}
+
+namespace check{
+    using Dec4 = Calculator<4u>;
+    using Hex4 = Calculator<4u, 0u, 16u>;
+    using Bin4 = Calculator<4u, 0u, 2u>;
+    using Dec6 = Calculator<6u>;
+
+    static_assert(shows(run<Dec4>("12+34E"), "46  "));
+    static_assert(shows(run<Dec4>("12D3"), "13  "));
+    static_assert(shows(run<Dec4>("12+3D"), "    "));
+    static_assert(shows(run<Dec4>("1234+5D"), "    "));
+    static_assert(shows(run<Dec4>("1234+5DD"), "1234"));
+    static_assert(shows(run<Dec4>("0012"), "12  "));
+    static_assert(!run<Dec4>("12345").digit(6u));
+        // A full second operand takes no third, and keeps its limit
+        //  after a delete
+    static_assert(!run<Dec4>("1+2345").op('-'));
+    static_assert(!run<Dec4>("1+2345D67").digit(8u));
+        // Negative results light the sign
+    static_assert(run<Dec4>("5-9E").shown_sign());
+    static_assert(shows(run<Dec4>("5-9E"), "4   "));
+        // Overloads show E, and chaining carries the full result
+    static_assert(run<Dec4>("1/0E").error());
+    static_assert(shows(run<Dec4>("1/0E"), "E   "));
+    static_assert(shows(run<Dec4>("2+3E*4E"), "20  "));
+        // Wide results come up on their top page
+    static_assert(run<Dec4>("9999*9999E").result() == 99980001u);
+    static_assert(shows(run<Dec4>("9999*9999E"), "9998"));
+    static_assert(shows(run<Dec4>("9999*9999EE"), "0001"));
+    static_assert(shows(run<Dec4>("9999*9999EEE"), "9998"));
+    static_assert(shows(run<Dec6>("999999*999999E"), "999998"));
+    static_assert(shows(run<Dec6>("999999*999999EE"), "000001"));
+        // Other radices, and the second function operators
+    static_assert(shows(run<Hex4>("ff+1E"), "100 "));
+    static_assert(shows(run<Hex4>("f0&3cE|1E"), "31  "));
+    static_assert(shows(run<Bin4>("1<11E"), "1000"));
+    static_assert(shows(run<Dec4>("1000>3E"), "125 "));
+    static_assert(run<Dec4>("9999<9999E").error());
+}
+
+}
+
+#endif
@@ -0,0 +1,50 @@
+#include "clock.h"
+#include "hal.h"
+
+static HAL_UNIT uint8_t policy = CLOCK_POLICY_SWITCH;
+static HAL_UNIT uint8_t profile = HAL_CLOCK_IDLE;
+static HAL_UNIT uint8_t depth;
+static HAL_UNIT uint32_t bursts;
+
+static void switch_to(uint8_t next){
+    if(next == profile) return;
+    hal_clock_set(next);
+    profile = next;
+    if(next == HAL_CLOCK_BURST) ++bursts;
+}
+
+void clock_init(void){
+    hal_clock_init();
+    profile = HAL_CLOCK_IDLE;
+    depth = 0u;
+    bursts = 0u;
+    clock_policy(policy);
+}
+
+void clock_policy(uint8_t new_policy){
+    policy = new_policy;
+    depth = 0u;
+    switch_to(policy == CLOCK_POLICY_BURST ? HAL_CLOCK_BURST : HAL_CLOCK_IDLE);
+}
+
+void clock_burst_begin(void){
+    if(depth++ || policy != CLOCK_POLICY_SWITCH)    return;
+    switch_to(HAL_CLOCK_BURST);
+}
+
+void clock_burst_end(void){
+    if(!depth || --depth || policy != CLOCK_POLICY_SWITCH)  return;
+    switch_to(HAL_CLOCK_IDLE);
+}
+
+uint8_t clock_profile(void){
+    return profile;
+}
+
+uint32_t clock_hz(void){
+    return profile == HAL_CLOCK_BURST ? HAL_CLOCK_BURST_HZ : HAL_CLOCK_IDLE_HZ;
+}
+
+uint32_t clock_bursts(void){
+    return bursts;
+}
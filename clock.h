@@ -0,0 +1,35 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+    // CPU clock profile manager. The CPU sits on the slow idle profile and
+    //  is raised to the burst profile around short stretches of work, key
+    //  handling and compute(), so that work finishes quickly and the core
+    //  goes back to sleep on the slow clock. Timers and the serial port
+    //  run off their own fixed clock (see hal.h) and are not disturbed by
+    //  a switch, nor are the waits and timeouts of sched.h, which count on
+    //  the timer.
+
+#include <stdint.h>
+
+    // What clock_burst_begin() does
+#define CLOCK_POLICY_SWITCH 0u      // Raise to burst for the work (default)
+#define CLOCK_POLICY_IDLE   1u      // Stay on the idle profile throughout
+#define CLOCK_POLICY_BURST  2u      // Stay on the burst profile throughout
+
+    // Set up the clock tree, ahead of every peripheral, and enter the
+    //  profile the policy starts in.
+void clock_init(void);
+    // Takes effect at once, and ends any burst in progress.
+void clock_policy(uint8_t policy);
+    // Bracket a stretch of work. Brackets may nest; the clock comes down
+    //  at the outermost end.
+void clock_burst_begin(void);
+void clock_burst_end(void);
+
+    // Current CPU clock
+uint8_t clock_profile(void);
+uint32_t clock_hz(void);
+    // Switches up to the burst profile since clock_init()
+uint32_t clock_bursts(void);
+
+#endif
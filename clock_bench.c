@@ -0,0 +1,157 @@
+    // Energy per keystroke and compute latency of the calculator under
+    //  each clock policy of clock.h, run on the host simulator.
+    //
+    //  Build:  cc -DHOST_SIM -O2 -o clock_bench
+    //              clock_bench.c host_sim.c main.c sched.c serial.c
+    //              clock.c persist.c trace.c
+    //  Usage:  clock_bench [trace_file]
+    //
+    // Without a file, a synthetic session is generated from a fixed seed:
+    //  expressions of two operands of one to four digits, each followed by
+    //  Enter, keyed at a steady pace. The whole firmware runs the same
+    //  trace once per policy, power-on blink and shutdown included.
+    //
+    // Reported per policy:
+    //  - time awake and asleep, split by CPU clock, and bursts to the fast
+    //    clock
+    //  - MCU energy per key press, from the energy model of host_sim.h.
+    //    The display draws the same under every policy and is left out.
+    //  - compute latency: from each Enter press edge until the display
+    //    changes, mean and max. This includes the debounce, which is the
+    //    same under every policy, so the policies differ by the time
+    //    compute() and the key handling take on their clock. Expressions
+    //    whose result looks like the operand on show are not counted.
+
+#include "hal.h"
+#include "clock.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_EXPRS         60u
+#define BENCH_SEED          0x2545F491u
+    // Past the power-on blink
+#define BENCH_START_US      2000000u
+#define BENCH_HOLD_US       80000u
+#define BENCH_GAP_US        220000u
+#define BENCH_READ_US       1000000u
+#define MAX_CHANGES         65536u
+
+struct policy{
+    const char* name;
+    uint8_t policy;
+};
+
+static const struct policy policies[] = {
+    {"idle",    CLOCK_POLICY_IDLE},
+    {"burst",   CLOCK_POLICY_BURST},
+    {"switch",  CLOCK_POLICY_SWITCH},
+};
+
+static uint64_t changes[MAX_CHANGES];
+static size_t change_count;
+
+static void record_change(void){
+    if(change_count < MAX_CHANGES)  changes[change_count++] = sim_cycles;
+}
+
+static uint32_t rng_state;
+static uint32_t rng_next(uint32_t bound){
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state % bound;
+}
+
+static void press(uint64_t* at, char name){
+    sim_inject(*at, sim_key_bits(name), 1);
+    *at += US_TO_CYCLES(BENCH_HOLD_US);
+    sim_inject(*at, sim_key_bits(name), 0);
+    *at += US_TO_CYCLES(BENCH_GAP_US);
+}
+
+static void press_operand(uint64_t* at){
+    uint32_t digits = 1u + rng_next(4u);
+    press(at, (char)('1' + rng_next(9u)));
+    while(--digits) press(at, (char)('0' + rng_next(10u)));
+}
+
+static void generate_trace(void){
+    static const char ops[] = "+-*/";
+    uint64_t at = US_TO_CYCLES(BENCH_START_US);
+    uint32_t n = 0;
+    rng_state = BENCH_SEED;
+    for(; n < BENCH_EXPRS; ++n){
+        press_operand(&at);
+        press(&at, ops[rng_next(4u)]);
+        press_operand(&at);
+        press(&at, 'E');
+        at += US_TO_CYCLES(BENCH_READ_US);
+    }
+}
+
+static void run_policy(const struct policy* p){
+    size_t count = 0, n = 0, c = 0, hits = 0, presses = 0;
+    const struct sim_event* ev = sim_trace(&count);
+    uint16_t enter = sim_key_bits('E');
+    uint64_t max = 0;
+    double mean = 0.0;
+
+    sim_rewind();
+    change_count = 0;
+    sim_display_hook = record_change;
+    clock_policy(p->policy);
+    firmware_main();
+    sim_display_hook = NULL;
+
+        // Each Enter owns the first display change before the next edge
+    for(; n < count; ++n){
+        uint64_t until = n + 1u < count ? ev[n+1].at : UINT64_MAX;
+        if(!ev[n].down) continue;
+        ++presses;
+        if(ev[n].keys != enter) continue;
+        for(; c < change_count && changes[c] <= ev[n].at; ++c);
+        if(c == change_count || changes[c] >= until)    continue;
+        mean += changes[c] - ev[n].at;
+        if(changes[c] - ev[n].at > max) max = changes[c] - ev[n].at;
+        ++hits;
+    }
+    if(hits)    mean /= hits;
+
+    uint64_t sleep_slow = sim_sleep_cycles - sim_fast_sleep_cycles;
+    uint64_t run_fast = sim_fast_cycles - sim_fast_sleep_cycles;
+    uint64_t run_slow = sim_cycles - sim_sleep_cycles - run_fast;
+    printf(
+        "%-8s %9.1f %9.1f %9.1f %9.1f %7lu %8.2f %8.3f %8.3f %5zu\n",
+        p->name,
+        CYCLES_TO_MS(run_slow), CYCLES_TO_MS(run_fast),
+        CYCLES_TO_MS(sleep_slow), CYCLES_TO_MS(sim_fast_sleep_cycles),
+        (unsigned long)clock_bursts(),
+        presses ? sim_energy.mcu / presses : 0.0,
+        CYCLES_TO_MS(mean), CYCLES_TO_MS(max), hits
+    );
+}
+
+int main(int argc, char* argv[]){
+    size_t n = 0;
+    if(argc > 1){
+        FILE* src = fopen(argv[1], "r");
+        if(src == NULL || sim_load_trace(src) < 0){
+            fprintf(stderr, "%s: cannot read trace %s\n", argv[0], argv[1]);
+            return 1;
+        }
+        fclose(src);
+    } else {
+        generate_trace();
+    }
+
+    printf(
+        "%-8s %9s %9s %9s %9s %7s %8s %8s %8s %5s\n",
+        "policy", "run_1M", "run_48M", "sleep_1M", "sleep_48M", "bursts",
+        "uJ/key", "ent_ms", "ent_max", "exprs"
+    );
+    for(; n < sizeof(policies) / sizeof(policies[0]); ++n)
+        run_policy(&policies[n]);
+    clock_policy(CLOCK_POLICY_SWITCH);
+    return 0;
+}
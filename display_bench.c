@@ -0,0 +1,154 @@
+    // Cost and ghosting of one digit update of the multiplexed display,
+    //  run on the host simulator.
+    //
+    //  Build:  cc -DHOST_SIM -O2 -o display_bench
+    //              display_bench.c host_sim.c main.c sched.c serial.c
+    //              clock.c persist.c trace.c
+    //  Usage:  display_bench [updates]
+    //
+    // Each variant lights the digits in turn, one per refresh tick as
+    //  display_task() does, with a fixed sequence of glyphs, dots and sign
+    //  changes. Every variant runs on both CPU clocks.
+    //
+    // "rmw" is display_dig() as it was before hal_dig_show(): blank, all
+    //  enables off, move the dimmer, glyph, dot, sign, each a
+    //  load/modify/store of OUT, and a glyph table that lights the dot
+    //  until the dot write fixes it. It is transcribed below on the same
+    //  port model. "main" is display_dig() linked from main.c.
+    //
+    // Reported per variant:
+    //  - CPU cycles and port writes per digit update
+    //  - ghosts: in-between patterns shown on a powered digit (see
+    //    sim_ghost_states in host_sim.h), per thousand updates, and how
+    //    long they glow per second of refresh
+
+#include "hal.h"
+#include "clock.h"
+
+#include <stdlib.h>
+
+#define BENCH_UPDATES       20000u
+#define BENCH_BLANK         0xFFu
+
+    // From main.c
+void display_dig(
+    uint32_t add_delay, uint8_t dig_to_display, uint8_t select,
+    uint8_t show_dot, uint8_t show_sign
+);
+void configure_ports(void);
+void set_initial_state(void);
+
+struct variant{
+    const char* name;
+    void (*show)(uint8_t num, uint8_t select, uint8_t dot, uint8_t sign);
+};
+
+struct profile{
+    const char* name;
+    uint8_t policy;
+};
+
+    /**********   Start variants   **********/
+static void rmw_a_set(uint32_t mask){
+    sim_port.out[0] |= mask;
+    sim_port_changed(SIM_CYC_PORT_RMW);
+}
+static void rmw_b_set(uint32_t mask){
+    sim_port.out[1] |= mask;
+    sim_port_changed(SIM_CYC_PORT_RMW);
+}
+static void rmw_b_clr(uint32_t mask){
+    sim_port.out[1] &= ~mask;
+    sim_port_changed(SIM_CYC_PORT_RMW);
+}
+
+static void rmw_show(uint8_t num, uint8_t select, uint8_t dot, uint8_t sign){
+        // Active low bus values, dot bit included
+    static const uint8_t glyphs[16] = {
+        0xBF, 0x86, 0xDB, 0xCF, 0xE6, 0xED, 0xFD, 0x87,
+        0x7F, 0xEF, 0xF7, 0xFC, 0xB9, 0xDE, 0xF9, 0xF1
+    };
+    rmw_b_set(SEG_BUS_MASK);
+    rmw_a_set(DIG_EN_MASK);
+    hal_dig_release();
+    hal_dig_pwm(select);
+    if(num < 16u){
+        rmw_b_clr(glyphs[num]);
+    } else {
+        rmw_b_set(SEG_BUS_MASK);
+        dot = 0;
+    }
+    if(dot) rmw_b_clr(SEG_DOT_MASK);
+    else    rmw_b_set(SEG_DOT_MASK);
+    if(sign)    rmw_b_clr(SIGN_LED_MASK);
+    else        rmw_b_set(SIGN_LED_MASK);
+}
+
+static void main_show(uint8_t num, uint8_t select, uint8_t dot, uint8_t sign){
+    display_dig(0u, num, select, dot, sign);
+}
+
+static const struct variant variants[] = {
+    {"rmw",     rmw_show},
+    {"main",    main_show},
+};
+    /**********   End variants     **********/
+
+static const struct profile profiles[] = {
+    {"1M",      CLOCK_POLICY_IDLE},
+    {"48M",     CLOCK_POLICY_BURST},
+};
+
+static void run_variant(
+    const struct variant* v, const struct profile* p, uint32_t updates
+){
+    uint32_t n = 0;
+    sim_rewind();
+    clock_policy(p->policy);
+    configure_ports();
+    set_initial_state();
+
+    uint64_t cycles = 0, writes = sim_port_writes;
+    uint64_t ghosts = sim_ghost_states, glow = sim_ghost_cycles;
+    for(; n < updates; ++n){
+            // Glyphs walk through 0 - F and blanks, the dot moves from
+            //  digit to digit and the sign flips now and then
+        uint8_t num = (n * 7u) % 17u;
+        uint64_t start = 0;
+        sim_sleep();
+        start = sim_cpu_cycles;
+        v->show(
+            num == 16u ? BENCH_BLANK : num, n % 4u,
+            (n / 4u) % 4u == n % 4u, (n / 64u) % 2u
+        );
+        cycles += sim_cpu_cycles - start;
+    }
+    writes = sim_port_writes - writes;
+    ghosts = sim_ghost_states - ghosts;
+    glow = sim_ghost_cycles - glow;
+
+    printf(
+        "%-7s %-4s %9.1f %8.2f %10.1f %10.2f\n",
+        v->name, p->name,
+        (double)cycles / updates, (double)writes / updates,
+        1000.0 * ghosts / updates,
+        (double)glow * 1000000.0 / SIM_CPU_HZ * TICK_HZ / updates
+    );
+}
+
+int main(int argc, char* argv[]){
+    uint32_t updates = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 0u;
+    size_t v = 0, p = 0;
+    if(updates == 0u)   updates = BENCH_UPDATES;
+
+    printf(
+        "%-7s %-4s %9s %8s %10s %10s\n",
+        "variant", "cpu", "cyc/upd", "writes", "ghosts/1k", "ghost_us/s"
+    );
+    for(; v < sizeof(variants) / sizeof(variants[0]); ++v){
+        for(p = 0; p < sizeof(profiles) / sizeof(profiles[0]); ++p)
+            run_variant(&variants[v], &profiles[p], updates);
+    }
+    clock_policy(CLOCK_POLICY_SWITCH);
+    return 0;
+}
@@ -0,0 +1,216 @@
+    // Many simulated calculators at once: random key sessions run on
+    //  every core, for fuzzing and for simulator throughput.
+    //
+    //  Build:  cc -DHOST_SIM -O2 -pthread -o farm
+    //              farm.c host_sim.c main.c sched.c serial.c
+    //              clock.c persist.c trace.c
+    //  Usage:  farm [units [workers [seed]]]
+    //
+    // Each unit is the whole firmware on factory fresh flash, keyed a
+    //  random session of its own from the seed and its number: digits,
+    //  operators, Enter and Delete, now and then the brightness, second
+    //  function, counter and termination chords and the power-on chord.
+    //  The state of a unit is thread local (HAL_UNIT in hal.h), so each
+    //  unit runs on a thread of its own and starts from a power up, with
+    //  every variable at its initial value. Each worker starts one unit
+    //  after another.
+    //
+    // All units run twice, with one worker and then with workers, and
+    //  each is summed up by a hash of every change of its display. A unit
+    //  whose hash differs between the runs has been disturbed by another,
+    //  or depends on something other than its keys; that makes the exit
+    //  status 1.
+    //
+    // Reported per run: wall time, units and simulated seconds per wall
+    //  second, and the speed up over one worker. Deadline overruns of the
+    //  scheduler are reported as the most any unit had.
+
+#include "hal.h"
+#include "sched.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_UNITS         400u
+#define BENCH_SEED          0x2545F491u
+#define UNIT_KEYS           24u
+    // Past the power-on blink
+#define BENCH_START_US      2000000u
+#define MAX_WORKERS         256u
+
+struct unit_result{
+    uint64_t hash;
+    uint64_t cycles;
+    uint32_t overruns;
+};
+
+struct run{
+    uint32_t units, seed;
+    struct unit_result* results;
+    atomic_uint next, failed;
+};
+
+struct job{
+    const struct run* run;
+    uint32_t unit;
+};
+
+    // Display hash of the unit the thread is running
+static SIM_UNIT uint64_t unit_hash;
+
+static void hash_display(void){
+    char text[16];
+    const char* c = text;
+    sim_render(text, sizeof(text));
+        // FNV-1a, with the end of each display hashed as well
+    for(; ; ++c){
+        unit_hash = (unit_hash ^ (uint8_t)*c) * 0x100000001B3u;
+        if(!*c) break;
+    }
+}
+
+static uint32_t rng_next(uint32_t* state, uint32_t bound){
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state % bound;
+}
+
+static void run_unit(const struct run* r, uint32_t unit){
+        // Weighted by how often each key is pressed
+    static const char keys[] = "0123456789012345678+-*/+-*/EEEEDDFBSQP";
+    uint32_t state = r->seed ^ (unit * 0x9E3779B9u), n = 0;
+    uint64_t at = US_TO_CYCLES(BENCH_START_US);
+    struct unit_result* result = &r->results[unit];
+    uint8_t id = 0;
+    if(!state)  state = BENCH_SEED;
+
+    for(; n < UNIT_KEYS; ++n){
+        uint16_t bits =
+            sim_key_bits(keys[rng_next(&state, sizeof(keys) - 1u)]);
+        sim_inject(at, bits, 1);
+        at += US_TO_CYCLES(40000u + rng_next(&state, 160000u));
+        sim_inject(at, bits, 0);
+        at += US_TO_CYCLES(80000u + rng_next(&state, 320000u));
+    }
+    sim_nvm_reset();
+    sim_rewind();
+    unit_hash = 0xCBF29CE484222325u;
+    sim_display_hook = hash_display;
+    firmware_main();
+    sim_display_hook = NULL;
+
+    result->hash = unit_hash;
+    result->cycles = sim_cycles;
+    result->overruns = 0;
+    for(; id < sched_count(); ++id)
+        result->overruns += sched_stats(id)->overruns;
+    sim_drop_trace();
+}
+
+static void* unit_thread(void* arg){
+    const struct job* j = arg;
+    run_unit(j->run, j->unit);
+    return NULL;
+}
+
+static void* run_worker(void* arg){
+    struct run* r = arg;
+    struct job j = {r, 0u};
+    pthread_t id;
+    while((j.unit = atomic_fetch_add(&r->next, 1u)) < r->units){
+        if(pthread_create(&id, NULL, unit_thread, &j) != 0){
+            atomic_store(&r->failed, 1u);
+            break;
+        }
+        pthread_join(id, NULL);
+    }
+    return NULL;
+}
+
+    // Run every unit on workers workers. Returns the wall time in s, or a
+    //  negative value when a thread could not be started.
+static double run_all(struct run* r, uint32_t workers){
+    static pthread_t ids[MAX_WORKERS];
+    struct timespec start, end;
+    uint32_t n = 0, started = 0;
+    atomic_store(&r->next, 0u);
+    atomic_store(&r->failed, 0u);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(; n < workers; ++n){
+        if(pthread_create(&ids[n], NULL, run_worker, r) == 0)   ++started;
+    }
+    for(n = 0; n < started; ++n)    pthread_join(ids[n], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if(started < workers || atomic_load(&r->failed))    return -1.0;
+    return (double)(end.tv_sec - start.tv_sec)
+        + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+static void print_run(
+    const struct run* r, uint32_t workers, double wall, double single
+){
+    uint64_t cycles = 0;
+    uint32_t n = 0;
+    for(; n < r->units; ++n)    cycles += r->results[n].cycles;
+    printf(
+        "%7u %8.2f %10.1f %10.0f %8.2fx\n", workers, wall,
+        wall > 0.0 ? r->units / wall : 0.0,
+        wall > 0.0 ? (double)cycles / SIM_CPU_HZ / wall : 0.0,
+        wall > 0.0 ? single / wall : 0.0
+    );
+}
+
+int main(int argc, char* argv[]){
+    uint32_t units = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 0u;
+    uint32_t workers = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 0u;
+    uint32_t seed = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 0) : 0u;
+    struct run r;
+    struct unit_result* alone = NULL;
+    uint32_t n = 0, differ = 0, overruns = 0;
+    double single = 0.0, wall = 0.0;
+    if(units == 0u) units = BENCH_UNITS;
+    if(workers == 0u)   workers = (uint32_t)sysconf(_SC_NPROCESSORS_ONLN);
+    if(workers == 0u)   workers = 1u;
+    if(workers > MAX_WORKERS)   workers = MAX_WORKERS;
+
+    r.units = units;
+    r.seed = seed ? seed : BENCH_SEED;
+    r.results = calloc(units, sizeof(*r.results));
+    alone = calloc(units, sizeof(*alone));
+    if(r.results == NULL || alone == NULL){
+        fprintf(stderr, "%s: out of memory\n", argv[0]);
+        return 1;
+    }
+
+    printf(
+        "%u units of %u keys\n%7s %8s %10s %10s %9s\n", units, UNIT_KEYS,
+        "workers", "wall_s", "units/s", "sim_s/s", "speed_up"
+    );
+    single = run_all(&r, 1u);
+    if(single >= 0.0){
+        print_run(&r, 1u, single, single);
+        for(n = 0; n < units; ++n)  alone[n] = r.results[n];
+        wall = run_all(&r, workers);
+    }
+    if(single < 0.0 || wall < 0.0){
+        fprintf(stderr, "%s: could not start threads\n", argv[0]);
+        return 1;
+    }
+    print_run(&r, workers, wall, single);
+
+    for(n = 0; n < units; ++n){
+        if(r.results[n].hash != alone[n].hash)  ++differ;
+        if(alone[n].overruns > overruns)    overruns = alone[n].overruns;
+    }
+    printf(
+        "%u units differ between runs, at most %u overruns in a unit\n",
+        differ, overruns
+    );
+    free(alone);
+    free(r.results);
+    return differ != 0u;
+}
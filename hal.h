@@ -0,0 +1,648 @@
+#ifndef HAL_H
+#define HAL_H
+
+    // Thin pin/port layer for the calculator board. Every signal the
+    //  firmware touches has a name here, and every access is a static
+    //  inline function so the target build compiles down to the same
+    //  code as poking bankA/bankB directly. Outputs change through
+    //  OUTSET/OUTCLR: one store, which no interrupt can split.
+    //
+    // The back end is picked at compile time:
+    //  - default:  SAMD20 registers through ASF
+    //  - HOST_SIM: the host simulator in host_sim.c
+    //
+    // RAM_HOT on the compiler command line runs the keypad scan and the
+    //  display refresh from RAM. Above 24 MHz every fetch from flash
+    //  takes a wait state, and these run every millisecond. Functions
+    //  marked HAL_RAMFUNC go to .ramfunc, and the tables they read,
+    //  marked HAL_RAMDATA, to .ramfunc.rodata. The ASF linker scripts
+    //  put .ramfunc.* in .relocate with .data, and ASF's Reset_Handler
+    //  copies .relocate from flash to RAM before main(). The code then
+    //  takes its size in RAM as well as flash: .relocate grows by it
+    //  and .text shrinks by it in arm-none-eabi-size -A. Calls into RAM
+    //  are long calls; calls back out to flash go through linker
+    //  veneers. The host simulator leaves the code where it is; see
+    //  sim_code_in_ram in host_sim.h for its model of the difference.
+    //
+    // Every variable a calculator unit changes, in any file, is declared
+    //  HAL_UNIT. On the target there is the one unit and HAL_UNIT is
+    //  nothing, so the firmware keeps plain static storage. On the host it
+    //  makes the variable thread local, the simulator's own state
+    //  included, so that each thread runs a unit of its own: the firmware
+    //  needs no context pointer passed around to be run many times over.
+
+#include <stdint.h>
+
+    /**********   Start signal map   **********/
+        // PORTA
+    // Digit enables for the seven segment displays. The same lines power
+    //  the keypad rows, so row n and digit n are one and the same pin.
+    //  Active low.
+#define DIG_EN_MASK     0x000000F0u     // PA4..PA7
+#define DIG_EN_SHIFT    4u
+    // Ready indicator LED. Active high.
+#define RDY_LED_MASK    0x00004000u     // PA14
+    // Keypad columns. Externally pulled low, active high.
+#define KEY_COL_MASK    0x000F0000u     // PA16..PA19
+#define KEY_COL_SHIFT   16u
+#define KEY_COL_ALL     0xFu
+#define KEY_COL_PINS    16u
+
+        // PORTB
+    // Segment bus. Active low.  DOT GFE DCBA
+#define SEG_BUS_MASK    0x000000FFu     // PB0..PB7
+#define SEG_DOT_MASK    0x00000080u     // PB7
+    // Extra dots on the display module that are never used.
+#define SEG_EXTRA_MASK  0x00000010u     // PB4
+    // Negative sign indicator. Active low.
+#define SIGN_LED_MASK   0x00000200u     // PB9
+
+    // While lit, a digit enable is handed to a TC waveform output so the
+    //  brightness follows the PWM duty cycle. TC0 drives PA4/PA5 and TC1
+    //  drives PA6/PA7, all on peripheral function E.
+#define DIM_PERIOD      0x3Fu           // One PWM period is 64 timer clocks
+#define DIM_PMUX_FUNC   0x4u
+
+    // Clocks. Every peripheral runs off GCLK1, which stays on OSC8M/8
+    //  (HAL_TIMER_HZ), so timer periods, the PWM and the baud rate do not
+    //  depend on the CPU clock. Only GCLK0, the CPU, switches profiles:
+    //  - HAL_CLOCK_IDLE:  OSC8M/8, the reset default, no flash wait state
+    //  - HAL_CLOCK_BURST: DFLL48M locked to OSC8M, one flash wait state
+#define HAL_CLOCK_IDLE      0u
+#define HAL_CLOCK_BURST     1u
+#define HAL_CLOCK_IDLE_HZ   1000000u
+#define HAL_CLOCK_BURST_HZ  48000000u
+    // DFLL reference: OSC8M/8 divided again by 32 on GCLK3, to keep it
+    //  under the 33 kHz the closed loop takes. Generators 3 - 7 have an 8
+    //  bit DIV field; GCLK2's is only 5 bits and would store 32 as 0,
+    //  which divides by 1.
+#define HAL_DFLL_REF_DIV    32u
+#define HAL_DFLL_REF_HZ     (HAL_CLOCK_IDLE_HZ / HAL_DFLL_REF_DIV)
+#define HAL_DFLL_REF_DIV_MAX    0xFFu
+_Static_assert(
+    HAL_DFLL_REF_DIV <= HAL_DFLL_REF_DIV_MAX,
+    "DFLL reference divider does not fit GCLK3's DIV field"
+);
+
+    // TC2 is the refresh timer. It interrupts once a millisecond and the
+    //  firmware counts the interrupts as its time base. For tickless idle
+    //  one period can be stretched over several ticks, as far as the 16
+    //  bit counter reaches.
+#define TICK_HZ         1000u
+#define HAL_TIMER_PER_TICK      (HAL_TIMER_HZ / TICK_HZ)
+#define HAL_TICK_STRETCH_MAX    (0x10000u / HAL_TIMER_PER_TICK)
+
+    // Serial port on SERCOM3: PA24 transmits on pad 2 and PA25 receives
+    //  on pad 3, both on peripheral function C. 8N1, no flow control. The
+    //  SERCOM runs off GCLK1 with 16x oversampling, which puts the ceiling
+    //  at 62500 baud.
+#define UART_PIN_MASK   0x03000000u     // PA24..PA25
+#define UART_PMUX_FUNC  0x2u
+#define UART_BAUD       38400u
+    // Arithmetic baud generator: BAUD = 65536 * (1 - 16 * baud / clock)
+#define UART_BAUD_REG   \
+    (65536u - (uint32_t)(((uint64_t)16u * 65536u * UART_BAUD) / HAL_TIMER_HZ))
+
+    // Persistent storage: the last HAL_NVM_ROWS rows of main flash, kept
+    //  from the program by setting the EEPROM fuse to HAL_NVM_SIZE bytes.
+    //  Offsets below count from the start of the region. A row is erased
+    //  as a whole, to all ones, and a page is written as a whole from the
+    //  page buffer, which can only clear bits. The CPU stalls on flash
+    //  fetches while either runs, for up to 6 ms for an erase and 2.5 ms
+    //  for a write.
+#define HAL_NVM_PAGE_SIZE   64u
+#define HAL_NVM_ROW_PAGES   4u
+#define HAL_NVM_ROW_SIZE    (HAL_NVM_PAGE_SIZE * HAL_NVM_ROW_PAGES)
+#define HAL_NVM_ROWS        4u
+#define HAL_NVM_SIZE        (HAL_NVM_ROW_SIZE * HAL_NVM_ROWS)
+
+    // CPU cycle counter for timing code, from SysTick. It counts at the
+    //  clock of the current profile and is 24 bits wide, so mask
+    //  differences of hal_cycles() with HAL_CYCLES_MASK. hal_work() charges
+    //  the simulator for cycles spent in code away from the port; it does
+    //  nothing on the target.
+#define HAL_CYCLES_MASK 0x00FFFFFFu
+    /**********   End signal map     **********/
+
+#ifdef HOST_SIM
+#include "host_sim.h"
+#define FIRMWARE_MAIN   firmware_main
+#define HAL_RUNNING()   sim_running()
+#define HAL_TIMER_HZ    SIM_CPU_HZ
+#define HAL_UNIT        SIM_UNIT
+#else
+#include <asf.h>
+#define FIRMWARE_MAIN   main
+#define HAL_RUNNING()   1
+#define HAL_TIMER_HZ    1000000u
+#define HAL_UNIT
+#endif
+
+#if defined(RAM_HOT) && !defined(HOST_SIM)
+#define HAL_RAMFUNC     __attribute__((section(".ramfunc"), long_call, noinline))
+#define HAL_RAMDATA     __attribute__((section(".ramfunc.rodata")))
+#else
+#define HAL_RAMFUNC
+#define HAL_RAMDATA
+#endif
+
+    // Refresh timer interrupt, defined by the firmware
+#define HAL_TICK_HANDLER    TC2_Handler
+void HAL_TICK_HANDLER(void);
+    // Serial port interrupt, defined by serial.c
+#define HAL_UART_HANDLER    SERCOM3_Handler
+void HAL_UART_HANDLER(void);
+
+    /**********   Start back end primitives   **********/
+#ifdef HOST_SIM
+static inline void hal_a_set(uint32_t mask){
+    sim_port.out[0] |= mask;
+    sim_port_changed(SIM_CYC_PORT_WRITE);
+}
+static inline void hal_a_clr(uint32_t mask){
+    sim_port.out[0] &= ~mask;
+    sim_port_changed(SIM_CYC_PORT_WRITE);
+}
+static inline uint32_t hal_a_in(void){
+    return sim_read_in_a();
+}
+static inline void hal_a_dir_out(uint32_t mask){
+    sim_port.dir[0] |= mask;
+}
+static inline void hal_a_dir_in(uint32_t mask){
+    sim_port.dir[0] &= ~mask;
+}
+static inline void hal_b_set(uint32_t mask){
+    sim_port.out[1] |= mask;
+    sim_port_changed(SIM_CYC_PORT_WRITE);
+}
+static inline void hal_b_clr(uint32_t mask){
+    sim_port.out[1] &= ~mask;
+    sim_port_changed(SIM_CYC_PORT_WRITE);
+}
+static inline void hal_b_dir_out(uint32_t mask){
+    sim_port.dir[1] |= mask;
+}
+
+static inline void hal_pins_init(void){
+        // Drive strength and input enables have no effect on the model
+}
+static inline void hal_dim_init(void){
+    sim_port.dim_period = DIM_PERIOD;
+}
+static inline void hal_dim_set(uint8_t duty){
+    sim_port.dim_duty = duty;
+    sim_port_changed(SIM_CYC_PORT_WRITE);
+}
+static inline void hal_dig_release(void){
+    sim_port.pmux_a &= ~DIG_EN_MASK;
+    sim_port_changed(SIM_CYC_PORT_WRITE);
+}
+static inline void hal_dig_pwm(uint8_t n){
+    sim_port.pmux_a |= 1u << (n + DIG_EN_SHIFT);
+    sim_port_changed(SIM_CYC_PORT_WRITE);
+}
+
+static inline void hal_clock_init(void){
+    sim_clock_set(HAL_CLOCK_IDLE_HZ);
+}
+    // The model CPU runs port accesses faster; timers are not affected.
+static inline void hal_clock_set(uint8_t profile){
+    sim_clock_set(
+        profile == HAL_CLOCK_BURST ? HAL_CLOCK_BURST_HZ : HAL_CLOCK_IDLE_HZ
+        );
+}
+
+static inline void hal_tick_init(void){
+    sim_tick_start(HAL_TIMER_PER_TICK);
+}
+static inline void hal_tick_ack(void){
+}
+static inline void hal_tick_stretch(uint32_t ticks){
+    sim_tick_stretch(ticks);
+}
+static inline uint8_t hal_tick_pending(void){
+    return sim_tick_pending();
+}
+static inline uint32_t hal_tick_count(void){
+    return sim_tick_count();
+}
+
+static inline void hal_irq_off(void){
+}
+static inline void hal_irq_on(void){
+}
+    // Sleep until the next interrupt
+static inline void hal_sleep(void){
+    sim_sleep();
+}
+
+    // The model UART moves one byte each way per character time.
+static inline void hal_uart_init(void){
+    sim_uart_enable();
+}
+static inline uint8_t hal_uart_rx_ready(void){
+    return sim_uart_rx_ready();
+}
+static inline uint8_t hal_uart_get(void){
+    return sim_uart_get();
+}
+static inline uint8_t hal_uart_tx_ready(void){
+    return sim_uart_tx_ready();
+}
+static inline void hal_uart_put(uint8_t byte){
+    sim_uart_put(byte);
+}
+static inline void hal_uart_tx_irq(uint8_t on){
+    sim_uart_tx_irq(on);
+}
+
+    // The model flash counts erases per row; see host_sim.h.
+static inline void hal_nvm_init(void){
+}
+static inline void hal_nvm_read(uint32_t offset, uint8_t* dest, uint32_t len){
+    sim_nvm_read(offset, dest, len);
+}
+static inline void hal_nvm_erase_row(uint32_t offset){
+    sim_nvm_erase_row(offset);
+}
+static inline void hal_nvm_write_page(uint32_t offset, const uint32_t* words){
+    sim_nvm_write_page(offset, words);
+}
+
+    // Virtual time only advances on port accesses, delays and work the
+    //  firmware declares with hal_work(), so other code takes no time here.
+static inline void hal_cycles_init(void){
+}
+static inline uint32_t hal_cycles(void){
+    return (uint32_t)sim_cpu_cycles & HAL_CYCLES_MASK;
+}
+static inline void hal_work(uint32_t cycles){
+    sim_work(cycles);
+}
+#else
+#define HAL_BANK_A      (&(PORT->Group[0]))
+#define HAL_BANK_B      (&(PORT->Group[1]))
+
+static inline void hal_a_set(uint32_t mask){
+    HAL_BANK_A->OUTSET.reg = mask;
+}
+static inline void hal_a_clr(uint32_t mask){
+    HAL_BANK_A->OUTCLR.reg = mask;
+}
+static inline uint32_t hal_a_in(void){
+    return HAL_BANK_A->IN.reg;
+}
+static inline void hal_a_dir_out(uint32_t mask){
+    HAL_BANK_A->DIR.reg |= mask;
+}
+static inline void hal_a_dir_in(uint32_t mask){
+    HAL_BANK_A->DIR.reg &= ~mask;
+}
+static inline void hal_b_set(uint32_t mask){
+    HAL_BANK_B->OUTSET.reg = mask;
+}
+static inline void hal_b_clr(uint32_t mask){
+    HAL_BANK_B->OUTCLR.reg = mask;
+}
+static inline void hal_b_dir_out(uint32_t mask){
+    HAL_BANK_B->DIR.reg |= mask;
+}
+
+static inline void hal_pins_init(void){
+    unsigned short i = 0;
+        // Set high drive strength on the digit enables
+    for(; i < 8; ++i){
+        HAL_BANK_A->PINCFG[i].reg |= PORT_PINCFG_DRVSTR;
+    }
+        // Enable input on the keypad columns. Note that the pins are
+        //  externally pulled low, so disable pull up.
+    for(i = KEY_COL_SHIFT; i < KEY_COL_SHIFT + 4u; ++i){
+        HAL_BANK_A->PINCFG[i].reg = PORT_PINCFG_INEN;
+    }
+}
+
+static inline void hal_clock_init(void){
+        // GCLK1 takes OSC8M, which its reset prescaler already divides by
+        //  8, and GCLK3 divides that down to the DFLL reference.
+    GCLK->GENDIV.reg = GCLK_GENDIV_ID(1) | GCLK_GENDIV_DIV(1);
+    GCLK->GENCTRL.reg =
+        GCLK_GENCTRL_ID(1) | GCLK_GENCTRL_SRC_OSC8M | GCLK_GENCTRL_GENEN;
+    while(GCLK->STATUS.bit.SYNCBUSY);
+    GCLK->GENDIV.reg = GCLK_GENDIV_ID(3) | GCLK_GENDIV_DIV(HAL_DFLL_REF_DIV);
+    GCLK->GENCTRL.reg =
+        GCLK_GENCTRL_ID(3) | GCLK_GENCTRL_SRC_OSC8M | GCLK_GENCTRL_GENEN;
+    while(GCLK->STATUS.bit.SYNCBUSY);
+    GCLK->CLKCTRL.reg =
+        GCLK_CLKCTRL_ID(SYSCTRL_GCLK_ID_DFLL48) | GCLK_CLKCTRL_GEN_GCLK3
+        | GCLK_CLKCTRL_CLKEN;
+    while(GCLK->STATUS.bit.SYNCBUSY);
+
+        // Lock the DFLL once in closed loop. ONDEMAND has to stay clear
+        //  while it is configured; once set, the DFLL only runs while GCLK0
+        //  asks for it and restarts from the locked value.
+    SYSCTRL->DFLLCTRL.reg = SYSCTRL_DFLLCTRL_ENABLE;
+    while(!SYSCTRL->PCLKSR.bit.DFLLRDY);
+    SYSCTRL->DFLLMUL.reg =
+        SYSCTRL_DFLLMUL_MUL(HAL_CLOCK_BURST_HZ / HAL_DFLL_REF_HZ)
+        | SYSCTRL_DFLLMUL_CSTEP(7) | SYSCTRL_DFLLMUL_FSTEP(63);
+    while(!SYSCTRL->PCLKSR.bit.DFLLRDY);
+    SYSCTRL->DFLLCTRL.reg = SYSCTRL_DFLLCTRL_ENABLE | SYSCTRL_DFLLCTRL_MODE;
+    while(!SYSCTRL->PCLKSR.bit.DFLLLCKC || !SYSCTRL->PCLKSR.bit.DFLLLCKF);
+    SYSCTRL->DFLLCTRL.reg |= SYSCTRL_DFLLCTRL_ONDEMAND;
+    while(!SYSCTRL->PCLKSR.bit.DFLLRDY);
+}
+    // The flash needs its wait state before the clock goes up, and keeps
+    //  it until the clock is down again.
+static inline void hal_clock_set(uint8_t profile){
+    if(profile == HAL_CLOCK_BURST){
+        NVMCTRL->CTRLB.bit.RWS = 1u;
+        GCLK->GENCTRL.reg =
+            GCLK_GENCTRL_ID(0) | GCLK_GENCTRL_SRC_DFLL48M
+            | GCLK_GENCTRL_GENEN;
+        while(GCLK->STATUS.bit.SYNCBUSY);
+    } else {
+        GCLK->GENCTRL.reg =
+            GCLK_GENCTRL_ID(0) | GCLK_GENCTRL_SRC_OSC8M | GCLK_GENCTRL_GENEN;
+        while(GCLK->STATUS.bit.SYNCBUSY);
+        NVMCTRL->CTRLB.bit.RWS = 0u;
+    }
+}
+
+static inline void hal_dim_init(void){
+        // TC0 and TC1 share one generic clock. GCLK1 keeps the PWM period
+        //  well below the time a digit is lit.
+    PM->APBCMASK.reg |= PM_APBCMASK_TC0 | PM_APBCMASK_TC1;
+    GCLK->CLKCTRL.reg =
+        GCLK_CLKCTRL_ID(TC0_GCLK_ID) | GCLK_CLKCTRL_GEN_GCLK1
+        | GCLK_CLKCTRL_CLKEN;
+    while(GCLK->STATUS.bit.SYNCBUSY);
+
+    Tc* dimmer[2] = {TC0, TC1};
+    uint8_t counter = 0x0;
+    for(; counter < 2; ++counter){
+        dimmer[counter]->COUNT8.CTRLA.reg =
+            TC_CTRLA_MODE_COUNT8 | TC_CTRLA_WAVEGEN_NPWM
+            | TC_CTRLA_PRESCALER_DIV1;
+            // Active low logic for the enables
+        dimmer[counter]->COUNT8.CTRLC.reg = TC_CTRLC_INVEN0 | TC_CTRLC_INVEN1;
+        dimmer[counter]->COUNT8.PER.reg = DIM_PERIOD;
+        while(dimmer[counter]->COUNT8.STATUS.bit.SYNCBUSY);
+        dimmer[counter]->COUNT8.CTRLA.reg |= TC_CTRLA_ENABLE;
+    }
+
+        // Select the waveform outputs for PA4..PA7. The mux itself is only
+        //  switched on per digit by hal_dig_pwm().
+    HAL_BANK_A->WRCONFIG.reg =
+        PORT_WRCONFIG_WRPMUX | PORT_WRCONFIG_PMUX(DIM_PMUX_FUNC)
+        | PORT_WRCONFIG_PINMASK(DIG_EN_MASK);
+}
+
+static inline void hal_dim_set(uint8_t duty){
+    TC0->COUNT8.CC[0].reg = duty;
+    TC0->COUNT8.CC[1].reg = duty;
+    TC1->COUNT8.CC[0].reg = duty;
+    TC1->COUNT8.CC[1].reg = duty;
+}
+
+static inline void hal_dig_release(void){
+        // One WRCONFIG write updates the PINCFG of all four pins. Keep
+        //  the high drive strength set up in hal_pins_init().
+    HAL_BANK_A->WRCONFIG.reg =
+        PORT_WRCONFIG_WRPINCFG | PORT_WRCONFIG_DRVSTR
+        | PORT_WRCONFIG_PINMASK(DIG_EN_MASK);
+}
+
+static inline void hal_dig_pwm(uint8_t n){
+    HAL_BANK_A->WRCONFIG.reg =
+        PORT_WRCONFIG_WRPINCFG | PORT_WRCONFIG_DRVSTR | PORT_WRCONFIG_PMUXEN
+        | PORT_WRCONFIG_PINMASK(1u << (n + DIG_EN_SHIFT));
+}
+
+static inline void hal_tick_init(void){
+    PM->APBCMASK.reg |= PM_APBCMASK_TC2;
+    GCLK->CLKCTRL.reg =
+        GCLK_CLKCTRL_ID(TC2_GCLK_ID) | GCLK_CLKCTRL_GEN_GCLK1
+        | GCLK_CLKCTRL_CLKEN;
+    while(GCLK->STATUS.bit.SYNCBUSY);
+
+        // Match frequency mode: the counter wraps at CC0, and each wrap
+        //  sets the overflow flag.
+    TC2->COUNT16.CTRLA.reg =
+        TC_CTRLA_MODE_COUNT16 | TC_CTRLA_WAVEGEN_MFRQ
+        | TC_CTRLA_PRESCALER_DIV1;
+    TC2->COUNT16.CC[0].reg = HAL_TIMER_PER_TICK - 1u;
+    TC2->COUNT16.INTENSET.reg = TC_INTENSET_OVF;
+    while(TC2->COUNT16.STATUS.bit.SYNCBUSY);
+    TC2->COUNT16.CTRLA.reg |= TC_CTRLA_ENABLE;
+    NVIC_EnableIRQ(TC2_IRQn);
+}
+static inline void hal_tick_ack(void){
+    TC2->COUNT16.INTFLAG.reg = TC_INTFLAG_OVF;
+}
+    // Make the tick in progress last ticks periods from its start. The new
+    //  CC0 takes a few timer clocks to synchronize, and the counter may
+    //  wrap at the old one meanwhile; the overflow flag is then set on
+    //  return and the new CC0 already applies to the next tick.
+static inline void hal_tick_stretch(uint32_t ticks){
+    TC2->COUNT16.CC[0].reg = ticks * HAL_TIMER_PER_TICK - 1u;
+    while(TC2->COUNT16.STATUS.bit.SYNCBUSY);
+}
+static inline uint8_t hal_tick_pending(void){
+    return TC2->COUNT16.INTFLAG.reg & TC_INTFLAG_OVF;
+}
+    // Timer clocks since the tick in progress began. COUNT has to be
+    //  synchronized from the timer clock domain before it can be read.
+static inline uint32_t hal_tick_count(void){
+    TC2->COUNT16.READREQ.reg = TC_READREQ_RREQ | TC_READREQ_ADDR(0x10);
+    while(TC2->COUNT16.STATUS.bit.SYNCBUSY);
+    return TC2->COUNT16.COUNT.reg;
+}
+
+static inline void hal_irq_off(void){
+    __disable_irq();
+}
+static inline void hal_irq_on(void){
+    __enable_irq();
+}
+    // Sleep until the next interrupt. One that is pending while interrupts
+    //  are off still wakes the core; it is taken after hal_irq_on().
+static inline void hal_sleep(void){
+    __WFI();
+}
+
+static inline void hal_uart_init(void){
+    PM->APBCMASK.reg |= PM_APBCMASK_SERCOM3;
+    GCLK->CLKCTRL.reg =
+        GCLK_CLKCTRL_ID(SERCOM3_GCLK_ID_CORE) | GCLK_CLKCTRL_GEN_GCLK1
+        | GCLK_CLKCTRL_CLKEN;
+    while(GCLK->STATUS.bit.SYNCBUSY);
+
+        // Internal clock, LSB first, TX on pad 2 and RX on pad 3
+    SERCOM3->USART.CTRLA.reg =
+        SERCOM_USART_CTRLA_MODE_USART_INT_CLK | SERCOM_USART_CTRLA_DORD
+        | SERCOM_USART_CTRLA_RXPO(3) | SERCOM_USART_CTRLA_TXPO;
+    SERCOM3->USART.BAUD.reg = UART_BAUD_REG;
+    SERCOM3->USART.CTRLB.reg =
+        SERCOM_USART_CTRLB_TXEN | SERCOM_USART_CTRLB_RXEN;
+    while(SERCOM3->USART.STATUS.bit.SYNCBUSY);
+    SERCOM3->USART.INTENSET.reg = SERCOM_USART_INTENSET_RXC;
+    SERCOM3->USART.CTRLA.reg |= SERCOM_USART_CTRLA_ENABLE;
+    while(SERCOM3->USART.STATUS.bit.SYNCBUSY);
+
+        // PA24 and PA25 sit in the upper half of the port
+    HAL_BANK_A->WRCONFIG.reg =
+        PORT_WRCONFIG_HWSEL | PORT_WRCONFIG_WRPINCFG | PORT_WRCONFIG_INEN
+        | PORT_WRCONFIG_PMUXEN | PORT_WRCONFIG_WRPMUX
+        | PORT_WRCONFIG_PMUX(UART_PMUX_FUNC)
+        | PORT_WRCONFIG_PINMASK(UART_PIN_MASK >> 16);
+    NVIC_EnableIRQ(SERCOM3_IRQn);
+}
+static inline uint8_t hal_uart_rx_ready(void){
+    return SERCOM3->USART.INTFLAG.reg & SERCOM_USART_INTFLAG_RXC;
+}
+    // Reading the data register clears the receive flag
+static inline uint8_t hal_uart_get(void){
+    return (uint8_t)SERCOM3->USART.DATA.reg;
+}
+static inline uint8_t hal_uart_tx_ready(void){
+    return SERCOM3->USART.INTFLAG.reg & SERCOM_USART_INTFLAG_DRE;
+}
+static inline void hal_uart_put(uint8_t byte){
+    SERCOM3->USART.DATA.reg = byte;
+}
+    // Interrupt whenever the transmitter can take another byte
+static inline void hal_uart_tx_irq(uint8_t on){
+    if(on)  SERCOM3->USART.INTENSET.reg = SERCOM_USART_INTENSET_DRE;
+    else    SERCOM3->USART.INTENCLR.reg = SERCOM_USART_INTENCLR_DRE;
+}
+
+#define HAL_NVM_BASE    (FLASH_ADDR + FLASH_SIZE - HAL_NVM_SIZE)
+
+static inline void hal_nvm_init(void){
+        // Page writes only when asked for, not on the last buffer word
+    NVMCTRL->CTRLB.bit.MANW = 1u;
+}
+static inline void hal_nvm_read(uint32_t offset, uint8_t* dest, uint32_t len){
+    const volatile uint8_t* src =
+        (const volatile uint8_t*)(uintptr_t)(HAL_NVM_BASE + offset);
+    for(; len > 0u; --len)  *dest++ = *src++;
+}
+    // Run one controller command on the row or page at offset. ADDR takes
+    //  16 bit word addresses.
+static inline void hal_nvm_command(uint32_t offset, uint32_t cmd){
+    while(!NVMCTRL->INTFLAG.bit.READY);
+    NVMCTRL->STATUS.reg = NVMCTRL_STATUS_MASK;
+    NVMCTRL->ADDR.reg = (HAL_NVM_BASE + offset) / 2u;
+    NVMCTRL->CTRLA.reg = cmd | NVMCTRL_CTRLA_CMDEX_KEY;
+    while(!NVMCTRL->INTFLAG.bit.READY);
+}
+static inline void hal_nvm_erase_row(uint32_t offset){
+    hal_nvm_command(offset, NVMCTRL_CTRLA_CMD_ER);
+}
+    // The page buffer only takes 16 and 32 bit writes
+static inline void hal_nvm_write_page(uint32_t offset, const uint32_t* words){
+    volatile uint32_t* dest =
+        (volatile uint32_t*)(uintptr_t)(HAL_NVM_BASE + offset);
+    uint32_t n = 0u;
+    hal_nvm_command(offset, NVMCTRL_CTRLA_CMD_PBC);
+    for(; n < HAL_NVM_PAGE_SIZE / 4u; ++n)  dest[n] = words[n];
+    hal_nvm_command(offset, NVMCTRL_CTRLA_CMD_WP);
+}
+
+static inline void hal_cycles_init(void){
+    SysTick->LOAD = HAL_CYCLES_MASK;
+    SysTick->VAL = 0u;
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+}
+    // SysTick counts down; turn it around so differences come out positive
+static inline uint32_t hal_cycles(void){
+    return HAL_CYCLES_MASK - SysTick->VAL;
+}
+static inline void hal_work(uint32_t cycles){
+    (void)cycles;
+}
+#endif
+    /**********   End back end primitives     **********/
+
+    /**********   Start named signals   **********/
+    // Segment bus. The masks are in lit-segment terms; the active low
+    //  inversion is handled here.
+static inline void hal_seg_on(uint32_t segs){
+    hal_b_clr(segs);
+}
+static inline void hal_seg_off(uint32_t segs){
+    hal_b_set(segs);
+}
+static inline void hal_seg_blank(void){
+    hal_b_set(SEG_BUS_MASK);
+}
+static inline void hal_dot_set(uint8_t on){
+    if(on)  hal_b_clr(SEG_DOT_MASK);
+    else    hal_b_set(SEG_DOT_MASK);
+}
+static inline void hal_sign_set(uint8_t on){
+    if(on)  hal_b_clr(SIGN_LED_MASK);
+    else    hal_b_set(SIGN_LED_MASK);
+}
+
+    // Digit enables / keypad rows.
+static inline void hal_dig_all_off(void){
+    hal_a_set(DIG_EN_MASK);
+}
+static inline void hal_dig_all_on(void){
+    hal_a_clr(DIG_EN_MASK);
+}
+static inline void hal_dig_on(uint8_t n){
+    hal_a_clr(1u << (n + DIG_EN_SHIFT));
+}
+    // Light digit n with segs, in lit-segment terms with the dot, and
+    //  set the sign indicator. The switch goes in blanking order so no
+    //  digit is ever powered with a pattern that is not its own: segments
+    //  dark, enables off, the dimmer moved to digit n, then the pattern.
+    //  Each port takes one OUTSET and at most one OUTCLR.
+static inline void hal_dig_show(uint8_t n, uint32_t segs, uint8_t sign){
+    uint32_t sign_on = sign ? SIGN_LED_MASK : 0x0u;
+    hal_b_set(SEG_BUS_MASK | (SIGN_LED_MASK & ~sign_on));
+    hal_dig_all_off();
+    hal_dig_release();
+    hal_dig_pwm(n);
+    hal_b_clr((segs & SEG_BUS_MASK) | sign_on);
+}
+    // Power one keypad row through the port, taking it back from the
+    //  dimmer first so it is driven for the whole read.
+static inline void hal_row_drive(uint8_t row){
+    hal_dig_release();
+    hal_dig_all_off();
+    hal_dig_on(row);
+}
+
+    // Keypad columns of the row being driven, one bit per column.
+static inline uint8_t hal_key_cols(void){
+    return (hal_a_in() >> KEY_COL_SHIFT) & KEY_COL_ALL;
+}
+
+    // Ready indicator.
+static inline void hal_rdy_set(uint8_t on){
+    if(on)  hal_a_set(RDY_LED_MASK);
+    else    hal_a_clr(RDY_LED_MASK);
+}
+
+    // Direction and pin configuration for every signal above.
+static inline void hal_init(void){
+    hal_a_dir_out(DIG_EN_MASK | RDY_LED_MASK);
+    hal_b_dir_out(SEG_BUS_MASK | SIGN_LED_MASK);
+    hal_a_dir_in(KEY_COL_MASK);
+    hal_pins_init();
+        // Turn off extra dots
+    hal_b_clr(SEG_EXTRA_MASK);
+
+    hal_dim_init();
+    hal_dig_release();
+    hal_cycles_init();
+    hal_tick_init();
+    hal_nvm_init();
+}
+    /**********   End named signals     **********/
+
+#endif
@@ -0,0 +1,770 @@
+    // For the pseudo-terminal calls and cfmakeraw()
+#define _GNU_SOURCE
+#include "hal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+    // Once the trace runs out, give the firmware this long to settle
+    //  before asking it to stop, and give up entirely after the limit.
+#define SIM_TAIL_US         500000u
+#define SIM_HANG_US         60000000u
+#define SIM_QUIT_HOLD_US    50000u
+    // Shortest time a pattern must be held to be seen at all
+#define SIM_MIN_LIT_CYCLES  20u
+
+    // One 8N1 character on the serial line
+#define SIM_UART_CHAR_CYCLES    (10u * SIM_CPU_HZ / UART_BAUD)
+#define SIM_UART_BUF        4096u
+
+SIM_UNIT struct sim_port_state sim_port;
+SIM_UNIT uint64_t sim_cycles;
+SIM_UNIT uint64_t sim_delay_cycles;
+SIM_UNIT uint64_t sim_sleep_cycles;
+SIM_UNIT uint32_t sim_cpu_hz = SIM_CPU_HZ;
+SIM_UNIT uint64_t sim_cpu_cycles;
+SIM_UNIT uint64_t sim_fast_cycles, sim_fast_sleep_cycles;
+SIM_UNIT uint8_t sim_code_in_ram;
+SIM_UNIT void (*sim_display_hook)(void);
+SIM_UNIT void (*sim_tick_hook)(void);
+SIM_UNIT uint32_t sim_persist_us = SIM_PERSIST_US;
+SIM_UNIT uint64_t sim_port_writes;
+SIM_UNIT uint64_t sim_ghost_states, sim_ghost_cycles;
+SIM_UNIT struct sim_energy sim_energy;
+SIM_UNIT uint32_t sim_nvm_erases[HAL_NVM_ROWS];
+
+static SIM_UNIT struct sim_event* events;
+static SIM_UNIT size_t event_count, event_cap, event_next;
+    // Events that came from the trace rather than from the simulator
+static SIM_UNIT size_t trace_count;
+static SIM_UNIT uint16_t keys_down;
+static SIM_UNIT int quit_sent;
+    // Refresh timer
+static SIM_UNIT uint32_t tick_period;
+static SIM_UNIT uint64_t tick_next, tick_last;
+static SIM_UNIT int in_isr;
+    // Cycles spent in interrupt handlers. A passing port state that an
+    //  interrupt happens to stretch is still a passing state, so this time
+    //  does not count towards how long a state was held.
+static SIM_UNIT uint64_t tick_cycles;
+    // CPU cycles charged but too short to make a whole cycle of virtual
+    //  time yet, in units of 1/(100*sim_cpu_hz) of a virtual cycle
+static SIM_UNIT uint64_t cpu_carry;
+    // Set while the time being passed is spent in hal_sleep()
+static SIM_UNIT int cpu_asleep;
+    // Currents drawn by the display and keypad in the present port state
+static SIM_UNIT double display_ma, keys_ma;
+
+    // Serial port: the pseudo-terminal master, and our own hold on the
+    //  slave side until the host first writes, so that the master does
+    //  not see a hang up before anyone has opened the port.
+static SIM_UNIT int uart_fd = -1, uart_peer = -1;
+static SIM_UNIT int uart_on, uart_tx_irq, uart_hung;
+static SIM_UNIT uint8_t uart_rx[SIM_UART_BUF], uart_tx[SIM_UART_BUF];
+static SIM_UNIT size_t uart_rx_len, uart_rx_pos, uart_tx_len;
+    // When the line is next free each way, the last traffic either way
+    //  and when the host hung up
+static SIM_UNIT uint64_t uart_rx_at, uart_tx_at, uart_heard, uart_end;
+    // While the line is quiet, virtual time is held to the real clock
+    //  from this pair of readings on, taken when the quiet began
+static SIM_UNIT int uart_paced;
+static SIM_UNIT uint64_t uart_pace_cycles;
+static SIM_UNIT struct timespec uart_pace_wall;
+
+    // Flash, kept inverted so that static storage starts out erased.
+    //  A cut is armed with its byte count plus one, and once it has hit
+    //  the flash is dead until the next power up.
+static SIM_UNIT uint8_t nvm_inv[HAL_NVM_SIZE];
+static SIM_UNIT uint32_t nvm_cut;
+static SIM_UNIT int nvm_dead;
+
+    // Port state as of the last change, so that each state can be judged
+    //  by how long it was actually held.
+static SIM_UNIT uint8_t  held_lit, held_powered, held_sign;
+static SIM_UNIT uint64_t held_since, held_at;
+
+    // Last lit pattern seen on each digit and when
+static SIM_UNIT uint8_t  view_segs[4];
+static SIM_UNIT uint64_t view_stamp[4];
+static SIM_UNIT uint64_t sign_stamp;
+static SIM_UNIT uint64_t view_sig;
+
+    // Lit segments (GFE DCBA) for 0 - F
+static const uint8_t glyph_segs[16] = {
+    0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07,
+    0x7F, 0x6F, 0x77, 0x7C, 0x39, 0x5E, 0x79, 0x71
+};
+static const char glyph_chars[] = "0123456789AbCdEF";
+
+static void queue_event(uint64_t at, uint16_t keys, uint8_t down);
+static void uart_poll(int wait_ms);
+static void uart_pace(uint64_t wait);
+static void update_load(void);
+
+static void apply_events(void){
+    size_t first = event_next;
+    for(; event_next < event_count; ++event_next){
+        if(events[event_next].at > sim_cycles)  break;
+        events[event_next].used = sim_energy;
+        if(events[event_next].down)
+            keys_down |= events[event_next].keys;
+        else
+            keys_down &= ~events[event_next].keys;
+    }
+    if(event_next != first) update_load();
+}
+
+static uint64_t trace_end(void){
+    uint64_t last = event_count ? events[event_count-1].at : 0;
+        // An open serial port counts as trace until the host hangs up
+    if(uart_fd >= 0){
+        uint64_t live = uart_hung ? uart_end : sim_cycles;
+        if(live > last) last = live;
+    }
+    return last + US_TO_CYCLES(SIM_TAIL_US);
+}
+
+    // Virtual time taken by cycles of CPU work at the current clock
+static uint64_t cpu_time(uint32_t cycles){
+    uint64_t taken = 0, per = (uint64_t)sim_cpu_hz * 100u;
+    uint32_t pct = 100u;
+    if(sim_cpu_hz > SIM_FLASH_0WS_HZ && !sim_code_in_ram)
+        pct += SIM_FLASH_WS_PCT;
+    cpu_carry += (uint64_t)cycles * SIM_CPU_HZ * pct;
+    taken = cpu_carry / per;
+    cpu_carry %= per;
+    return taken;
+}
+
+static void pass(uint64_t cycles){
+    double mcu_ma = sim_cpu_hz > SIM_CPU_HZ
+        ? (cpu_asleep ? SIM_SLEEP_FAST_MA : SIM_RUN_FAST_MA)
+        : (cpu_asleep ? SIM_SLEEP_SLOW_MA : SIM_RUN_SLOW_MA);
+        // V * mA * ms comes out in uJ
+    double v_ms = SIM_SUPPLY_V * cycles * 1000.0 / SIM_CPU_HZ;
+    sim_energy.mcu += mcu_ma * v_ms;
+    sim_energy.display += display_ma * v_ms;
+    sim_energy.keys += keys_ma * v_ms;
+        // Only the wait itself is slept; the interrupt that ends it is not
+    cpu_asleep = 0;
+
+    sim_cycles += cycles;
+    sim_cpu_cycles += cycles * (sim_cpu_hz / SIM_CPU_HZ);
+    if(sim_cpu_hz > SIM_CPU_HZ) sim_fast_cycles += cycles;
+}
+
+static void advance(uint64_t cycles){
+    uint64_t isr = 0;
+    pass(cycles);
+    while(tick_period && !in_isr && sim_cycles >= tick_next){
+        tick_last = tick_next;
+        tick_next += tick_period;
+        isr = cpu_time(SIM_CYC_ISR);
+        pass(isr);
+        tick_cycles += isr;
+        in_isr = 1;
+        HAL_TICK_HANDLER();
+        in_isr = 0;
+        uart_poll(0);
+        if(sim_tick_hook)   sim_tick_hook();
+    }
+    if(
+        uart_on && !in_isr
+        && (sim_uart_rx_ready() || (uart_tx_irq && sim_uart_tx_ready()))
+    ){
+        isr = cpu_time(SIM_CYC_ISR);
+        pass(isr);
+        tick_cycles += isr;
+        in_isr = 1;
+        HAL_UART_HANDLER();
+        in_isr = 0;
+    }
+    apply_events();
+    if(sim_cycles > trace_end() + US_TO_CYCLES(SIM_HANG_US)){
+        fprintf(stderr, "sim: firmware did not stop after the trace\n");
+        exit(2);
+    }
+}
+
+    // Whether digit n is being powered right now
+static int dig_powered(uint8_t n){
+    uint32_t pin = 1u << (n + DIG_EN_SHIFT);
+    if(!(sim_port.dir[0] & pin))    return 0;
+    if(sim_port.pmux_a & pin)       return sim_port.dim_duty != 0;
+    return !(sim_port.out[0] & pin);
+}
+
+    // Share of the time digit n is powered: all of it when the port
+    //  drives it, the dimmer duty when the dimmer does
+static double dig_duty(uint8_t n){
+    uint32_t pin = 1u << (n + DIG_EN_SHIFT);
+    uint32_t period = sim_port.dim_period + 1u;
+    if(!dig_powered(n)) return 0.0;
+    if(!(sim_port.pmux_a & pin))    return 1.0;
+    if(sim_port.dim_duty >= period) return 1.0;
+    return (double)sim_port.dim_duty / period;
+}
+
+static uint8_t count_bits(uint32_t bits){
+    uint8_t count = 0;
+    for(; bits; bits &= bits - 1u)  ++count;
+    return count;
+}
+
+static void update_load(void){
+    uint8_t n = 0, lit = 0;
+    display_ma = keys_ma = 0.0;
+    lit = count_bits(~sim_port.out[1] & sim_port.dir[1] & SEG_BUS_MASK);
+    for(; n < 4; ++n){
+        double duty = dig_duty(n);
+        display_ma += lit * SIM_SEG_MA * duty;
+        keys_ma +=
+            count_bits((keys_down >> (n * 4u)) & KEY_COL_ALL)
+            * SIM_KEY_MA * duty;
+    }
+    if(
+        (sim_port.dir[1] & SIGN_LED_MASK)
+        && !(sim_port.out[1] & SIGN_LED_MASK)
+    )   display_ma += SIM_SEG_MA;
+}
+
+    // Everything visible packed into one word: the lit segments of digit
+    //  n in byte n and the sign indicator in bit 32.
+static uint64_t visible_sig(void){
+    uint64_t horizon =
+        sim_cycles > US_TO_CYCLES(sim_persist_us)
+        ? sim_cycles - US_TO_CYCLES(sim_persist_us) : 0;
+    uint64_t sig = 0;
+    uint8_t n = 0;
+    for(; n < 4; ++n){
+        if(view_stamp[n] && view_stamp[n] >= horizon)
+            sig |= (uint64_t)view_segs[n] << (8u * n);
+    }
+    if(sign_stamp && sign_stamp >= horizon) sig |= (uint64_t)1 << 32;
+    return sig;
+}
+
+void sim_reset_port(void){
+    memset(&sim_port, 0, sizeof(sim_port));
+    memset(view_segs, 0, sizeof(view_segs));
+    memset(view_stamp, 0, sizeof(view_stamp));
+    sign_stamp = 0;
+    view_sig = 0;
+    held_lit = held_powered = held_sign = 0;
+    held_since = sim_cycles - tick_cycles;
+    held_at = sim_cycles;
+    update_load();
+}
+
+void sim_port_changed(uint32_t cycles){
+    advance(cpu_time(cycles));
+    ++sim_port_writes;
+
+        // The state that just ended only counts as visible if it was held
+        //  long enough; the in-between states of a digit update do not.
+    uint8_t n = 0, powered = 0, lit = ~sim_port.out[1] & SEG_BUS_MASK;
+    if(sim_cycles - tick_cycles - held_since >= SIM_MIN_LIT_CYCLES){
+        for(; held_lit && n < 4; ++n){
+            if(!((held_powered >> n) & 0x1))    continue;
+            view_segs[n] = held_lit;
+            view_stamp[n] = sim_cycles;
+        }
+        if(held_sign)   sign_stamp = sim_cycles;
+    }
+    for(n = 0; n < 4; ++n)  powered |= dig_powered(n) << n;
+        // An in-between pattern on a digit that stays lit is a ghost. It
+        //  glows for as long as it was really held, interrupts included.
+    if(
+        held_lit && (held_powered & powered) && lit != held_lit
+        && sim_cycles - tick_cycles - held_since < SIM_MIN_LIT_CYCLES
+    ){
+        ++sim_ghost_states;
+        sim_ghost_cycles += sim_cycles - held_at;
+    }
+
+    held_lit = lit;
+    held_powered = powered;
+    held_sign =
+        (sim_port.dir[1] & SIGN_LED_MASK)
+        && !(sim_port.out[1] & SIGN_LED_MASK);
+    held_since = sim_cycles - tick_cycles;
+    held_at = sim_cycles;
+    update_load();
+
+    uint64_t sig = visible_sig();
+    if(sig != view_sig){
+        view_sig = sig;
+        if(sim_display_hook)    sim_display_hook();
+    }
+}
+
+uint32_t sim_read_in_a(void){
+    advance(cpu_time(SIM_CYC_PORT_READ));
+
+        // Ask a calculator that is still running at the end of the trace
+        //  to shut down, so the run always ends in the idle loop.
+    if(!quit_sent && sim_cycles >= trace_end()){
+        quit_sent = 1;
+        queue_event(sim_cycles, sim_key_bits('Q'), 1);
+        queue_event(
+            sim_cycles + US_TO_CYCLES(SIM_QUIT_HOLD_US), sim_key_bits('Q'), 0
+        );
+        apply_events();
+    }
+
+    uint32_t cols = 0;
+    uint8_t row = 0;
+    uint8_t pwm_on =
+        sim_port.dim_duty > sim_cycles % (sim_port.dim_period + 1u);
+    for(; row < 4; ++row){
+        uint32_t pin = 1u << (row + DIG_EN_SHIFT);
+        if(!(sim_port.dir[0] & pin))    continue;
+        if(sim_port.pmux_a & pin ? !pwm_on : (sim_port.out[0] & pin))
+            continue;
+        cols |= (keys_down >> (row * 4u)) & KEY_COL_ALL;
+    }
+    return (sim_port.out[0] & ~KEY_COL_MASK) | (cols << KEY_COL_SHIFT);
+}
+
+void sim_tick_start(uint32_t period){
+    tick_period = period;
+    tick_last = sim_cycles;
+    tick_next = sim_cycles + period;
+}
+
+void sim_tick_stretch(uint32_t ticks){
+    tick_next = tick_last + (uint64_t)ticks * tick_period;
+}
+
+int sim_tick_pending(void){
+    return tick_period && sim_cycles >= tick_next;
+}
+
+uint32_t sim_tick_count(void){
+    advance(cpu_time(SIM_CYC_PORT_READ));
+    return (uint32_t)(sim_cycles - tick_last);
+}
+
+void sim_sleep(void){
+    uint64_t wait = tick_period && tick_next > sim_cycles
+        ? tick_next - sim_cycles : SIM_CYC_PORT_READ;
+        // The UART interrupt wakes the core as well
+    if(uart_on && uart_rx_pos < uart_rx_len && uart_rx_at < sim_cycles + wait)
+        wait = uart_rx_at > sim_cycles ? uart_rx_at - sim_cycles : 1u;
+    if(uart_on && uart_tx_irq && uart_tx_at < sim_cycles + wait)
+        wait = uart_tx_at > sim_cycles ? uart_tx_at - sim_cycles : 1u;
+        // Nothing to do on either side: sleep in real time, or until the
+        //  host writes
+    if(
+        uart_fd >= 0 && !uart_hung && event_next == event_count
+        && uart_rx_pos == uart_rx_len
+        && sim_cycles - uart_heard >= US_TO_CYCLES(SIM_UART_QUIET_US)
+    )   uart_pace(wait);
+    else    uart_paced = 0;
+    sim_sleep_cycles += wait;
+    if(sim_cpu_hz > SIM_CPU_HZ) sim_fast_sleep_cycles += wait;
+    cpu_asleep = 1;
+    advance(wait);
+}
+
+void sim_clock_set(uint32_t hz){
+    if(hz == sim_cpu_hz)    return;
+    sim_cpu_hz = hz;
+    advance(US_TO_CYCLES(SIM_CLOCK_SWITCH_US));
+}
+
+void sim_work(uint32_t cycles){
+        // Only firmware running on the timer is charged; tools that call
+        //  into main.c directly leave virtual time alone
+    if(tick_period) advance(cpu_time(cycles));
+}
+
+int sim_running(void){
+    return event_next < event_count || sim_cycles < trace_end();
+}
+
+void sim_nvm_reset(void){
+    memset(nvm_inv, 0, sizeof(nvm_inv));
+    memset(sim_nvm_erases, 0, sizeof(sim_nvm_erases));
+    nvm_cut = 0;
+    nvm_dead = 0;
+}
+
+void sim_nvm_cut(uint32_t bytes){
+    nvm_cut = bytes + 1u;
+}
+
+    // How many of len bytes the next operation gets through
+static uint32_t nvm_span(uint32_t len){
+    if(nvm_dead)    return 0;
+    if(!nvm_cut)    return len;
+    if(nvm_cut - 1u < len)  len = nvm_cut - 1u;
+    nvm_cut = 0;
+    nvm_dead = 1;
+    return len;
+}
+
+void sim_nvm_read(uint32_t offset, uint8_t* dest, uint32_t len){
+    for(; len > 0u && offset < HAL_NVM_SIZE; --len)
+        *dest++ = (uint8_t)~nvm_inv[offset++];
+}
+
+void sim_nvm_erase_row(uint32_t offset){
+    uint32_t row = offset / HAL_NVM_ROW_SIZE, n = 0;
+    uint32_t span = nvm_span(HAL_NVM_ROW_SIZE);
+    if(row >= HAL_NVM_ROWS) return;
+    if(span)    ++sim_nvm_erases[row];
+    for(; n < span; ++n)    nvm_inv[row * HAL_NVM_ROW_SIZE + n] = 0;
+    advance(US_TO_CYCLES(SIM_NVM_ERASE_US));
+}
+
+void sim_nvm_write_page(uint32_t offset, const uint32_t* words){
+    uint32_t page = offset / HAL_NVM_PAGE_SIZE * HAL_NVM_PAGE_SIZE, n = 0;
+    uint32_t span = nvm_span(HAL_NVM_PAGE_SIZE);
+    if(page >= HAL_NVM_SIZE)    return;
+        // Programming only clears bits, little endian words
+    for(; n < span; ++n)
+        nvm_inv[page + n] |= (uint8_t)~(words[n / 4u] >> (8u * (n % 4u)));
+    advance(US_TO_CYCLES(SIM_NVM_WRITE_US));
+}
+
+void delay_init(void){
+}
+
+void delay_us(uint32_t us){
+    sim_delay_cycles += US_TO_CYCLES(us);
+    advance(US_TO_CYCLES(us));
+}
+
+void delay_ms(uint32_t ms){
+    sim_delay_cycles += US_TO_CYCLES((uint64_t)ms * 1000u);
+    advance(US_TO_CYCLES((uint64_t)ms * 1000u));
+}
+
+    // Move bytes between the model UART and the pseudo-terminal. A full
+    //  pseudo-terminal holds the simulation up until the host reads.
+static void uart_flush(void){
+    size_t sent = 0;
+    while(sent < uart_tx_len && !uart_hung){
+        ssize_t put = write(uart_fd, uart_tx + sent, uart_tx_len - sent);
+        if(put > 0){
+            sent += (size_t)put;
+        } else if(put < 0 && errno == EAGAIN){
+            struct pollfd wait = {uart_fd, POLLOUT, 0};
+            if(poll(&wait, 1, -1) > 0 && !(wait.revents & POLLHUP))
+                continue;
+            uart_hung = 1;
+            uart_end = sim_cycles;
+        } else if(put < 0 && errno != EINTR){
+            uart_hung = 1;
+            uart_end = sim_cycles;
+        }
+    }
+    uart_tx_len = 0;
+}
+
+    // Wait up to wait_ms of real time for the host to write
+static void uart_poll(int wait_ms){
+    if(uart_fd < 0 || uart_hung)    return;
+    uart_flush();
+    if(uart_rx_pos < uart_rx_len)   return;
+
+    struct pollfd wait = {uart_fd, POLLIN, 0};
+    if(poll(&wait, 1, wait_ms) <= 0)    return;
+    ssize_t got = read(uart_fd, uart_rx, sizeof(uart_rx));
+    if(got > 0){
+        uart_rx_pos = 0;
+        uart_rx_len = (size_t)got;
+        uart_heard = sim_cycles;
+            // The host is here; from now on its hang up ends the run
+        if(uart_peer >= 0){
+            close(uart_peer);
+            uart_peer = -1;
+        }
+    } else if(got == 0 || (errno != EAGAIN && errno != EINTR)){
+        uart_hung = 1;
+        uart_end = sim_cycles;
+    }
+}
+
+    // Wait until the real clock catches up with the end of a sleep of wait
+    //  cycles. Sleeps are mostly shorter than the 1 ms poll() counts in,
+    //  so the time ahead is kept against the readings taken when the line
+    //  went quiet, and slept off once it comes to a whole ms.
+static void uart_pace(uint64_t wait){
+    struct timespec now;
+    uint64_t cycles = 0;
+    int64_t ahead_us = 0;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if(!uart_paced){
+        uart_paced = 1;
+        uart_pace_cycles = sim_cycles;
+        uart_pace_wall = now;
+    }
+    cycles = sim_cycles + wait - uart_pace_cycles;
+    ahead_us = (int64_t)(
+        cycles / SIM_CPU_HZ * 1000000u
+        + cycles % SIM_CPU_HZ * 1000000u / SIM_CPU_HZ
+    )
+        - (int64_t)(now.tv_sec - uart_pace_wall.tv_sec) * 1000000
+        - (now.tv_nsec - uart_pace_wall.tv_nsec) / 1000;
+    uart_poll(ahead_us > 0 ? (int)(ahead_us / 1000) : 0);
+}
+
+const char* sim_uart_open(void){
+    struct termios raw;
+    const char* name = NULL;
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if(fd < 0)  return NULL;
+    if(grantpt(fd) || unlockpt(fd) || (name = ptsname(fd)) == NULL){
+        close(fd);
+        return NULL;
+    }
+    uart_peer = open(name, O_RDWR | O_NOCTTY);
+    if(uart_peer < 0){
+        close(fd);
+        return NULL;
+    }
+        // Bytes through untouched: no echo, no line editing, no CR/LF
+        //  translation
+    if(tcgetattr(uart_peer, &raw) == 0){
+        cfmakeraw(&raw);
+        tcsetattr(uart_peer, TCSANOW, &raw);
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    uart_fd = fd;
+    uart_hung = 0;
+    uart_heard = sim_cycles;
+    return name;
+}
+
+void sim_uart_close(void){
+    if(uart_fd < 0) return;
+    uart_flush();
+    if(uart_peer >= 0)  close(uart_peer);
+    close(uart_fd);
+    uart_fd = uart_peer = -1;
+}
+
+void sim_uart_enable(void){
+    uart_on = 1;
+    uart_tx_irq = 0;
+    uart_rx_at = uart_tx_at = sim_cycles;
+}
+
+int sim_uart_rx_ready(void){
+    return uart_rx_pos < uart_rx_len && sim_cycles >= uart_rx_at;
+}
+
+uint8_t sim_uart_get(void){
+    uint8_t byte = uart_rx[uart_rx_pos++];
+    uart_rx_at = sim_cycles + SIM_UART_CHAR_CYCLES;
+    if(uart_rx_pos == uart_rx_len)  uart_rx_pos = uart_rx_len = 0;
+    return byte;
+}
+
+int sim_uart_tx_ready(void){
+    return sim_cycles >= uart_tx_at;
+}
+
+void sim_uart_put(uint8_t byte){
+    uart_tx_at = sim_cycles + SIM_UART_CHAR_CYCLES;
+    if(uart_fd < 0) return;
+    uart_heard = sim_cycles;
+    uart_tx[uart_tx_len++] = byte;
+    if(uart_tx_len == SIM_UART_BUF) uart_flush();
+}
+
+void sim_uart_tx_irq(int on){
+    uart_tx_irq = on;
+}
+
+uint16_t sim_key_bits(char name){
+    static const char layout[SIM_KEYS + 1] = "/+0-*987D654E321";
+    const char* at = strchr(layout, name);
+    if(name && at)  return 1u << (at - layout);
+    switch(name){
+        case 'P':   return 0x000F;  // Whole of row 0
+        case 'Q':   return 0xB000;  // Row 3, columns 0xB
+        case 'T':   return 0xD000;  // Row 3, columns 0xD
+        case 'B':   return 0x5000;  // Row 3, columns 0x5
+        case 'F':   return 0x0009;  // Row 0, columns 0x9
+        case 'S':   return 0x9000;  // Row 3, columns 0x9
+        default:    return 0;
+    }
+}
+
+static void queue_event(uint64_t at, uint16_t keys, uint8_t down){
+    if(event_count == event_cap){
+        event_cap = event_cap ? event_cap * 2u : 64u;
+        events = realloc(events, event_cap * sizeof(*events));
+        if(events == NULL){
+            fprintf(stderr, "sim: out of memory\n");
+            exit(2);
+        }
+    }
+        // Keep the list sorted; traces are nearly always appended in order
+    size_t slot = event_count++;
+    for(; slot > event_next && events[slot-1].at > at; --slot)
+        events[slot] = events[slot-1];
+    events[slot].at = at;
+    events[slot].keys = keys;
+    events[slot].down = down;
+}
+
+void sim_inject(uint64_t at, uint16_t keys, uint8_t down){
+    queue_event(at, keys, down);
+    trace_count = event_count;
+}
+
+long sim_load_trace(FILE* src){
+    char line[128];
+    long loaded = 0;
+    while(fgets(line, sizeof(line), src)){
+        char* text = line;
+        while(*text == ' ' || *text == '\t')    ++text;
+        if(*text == '#' || *text == '\n' || *text == '\0')  continue;
+
+        unsigned long long at_us;
+        char name;
+        unsigned down;
+        if(sscanf(text, "%llu %c %u", &at_us, &name, &down) != 3
+            || !sim_key_bits(name) || down > 1
+        )   return -1;
+        sim_inject(US_TO_CYCLES(at_us), sim_key_bits(name), (uint8_t)down);
+        ++loaded;
+    }
+    return loaded;
+}
+
+const struct sim_event* sim_trace(size_t* count){
+    *count = trace_count;
+    return events;
+}
+
+void sim_rewind(void){
+    sim_cycles = sim_delay_cycles = sim_sleep_cycles = 0;
+    sim_port_writes = sim_ghost_states = sim_ghost_cycles = 0;
+    nvm_dead = 0;
+    memset(&sim_energy, 0, sizeof(sim_energy));
+    sim_cpu_hz = SIM_CPU_HZ;
+    sim_cpu_cycles = sim_fast_cycles = sim_fast_sleep_cycles = 0;
+    cpu_carry = 0;
+    event_count = trace_count;
+    event_next = 0;
+    keys_down = 0;
+    quit_sent = 0;
+    tick_period = 0;
+    tick_last = tick_next = 0;
+    tick_cycles = 0;
+    sim_reset_port();
+}
+
+void sim_drop_trace(void){
+    free(events);
+    events = NULL;
+    event_count = event_cap = event_next = trace_count = 0;
+}
+
+void sim_render(char* dest, size_t len){
+    uint64_t sig = visible_sig();
+    size_t used = 0;
+    int n = 3;
+    if(len == 0)    return;
+    if(used + 1 < len)  dest[used++] = (sig >> 32) ? '-' : ' ';
+    for(; n >= 0; --n){
+        uint8_t segs = (sig >> (8u * n)) & 0x7F;
+        char glyph = segs ? '?' : ' ';
+        uint8_t g = 0;
+        for(; g < 16; ++g){
+            if(glyph_segs[g] == segs){
+                glyph = glyph_chars[g];
+                break;
+            }
+        }
+        if(used + 1 < len)  dest[used++] = glyph;
+        if(((sig >> (8u * n + 7u)) & 0x1) && used + 1 < len)
+            dest[used++] = '.';
+    }
+    dest[used] = '\0';
+}
+
+double sim_energy_total(void){
+    return sim_energy.mcu + sim_energy.display + sim_energy.keys;
+}
+
+void sim_energy_report(FILE* dest){
+    uint16_t down = 0, enter = sim_key_bits('E');
+    uint64_t idle_cycles = 0, at = 0;
+    struct sim_energy idle = {0}, from = {0};
+    double key_uj = 0.0, enter_uj = 0.0;
+    size_t n = 0, keys = 0, enters = 0;
+    int is_enter = 0;
+
+    fprintf(dest,
+        "energy %.1f uJ over %.3f s: mcu %.1f, display %.1f, keys %.1f\n",
+        sim_energy_total(), (double)sim_cycles / SIM_CPU_HZ,
+        sim_energy.mcu, sim_energy.display, sim_energy.keys
+    );
+
+        // First the idle power, from the time between a release and the
+        //  next press
+    for(; n < event_next && n < trace_count; ++n){
+        if(events[n].down && !down && at){
+            idle_cycles += events[n].at - at;
+            idle.mcu += events[n].used.mcu - from.mcu;
+            idle.display += events[n].used.display - from.display;
+            idle.keys += events[n].used.keys - from.keys;
+        }
+        if(events[n].down)  down |= events[n].keys;
+        else                down &= ~events[n].keys;
+        if(!events[n].down && !down){
+            at = events[n].at;
+            from = events[n].used;
+        }
+    }
+    if(idle_cycles){
+        idle.mcu *= (double)SIM_CPU_HZ / idle_cycles;
+        idle.display *= (double)SIM_CPU_HZ / idle_cycles;
+        idle.keys *= (double)SIM_CPU_HZ / idle_cycles;
+    }
+
+        // Then each keystroke over the idle power
+    for(n = 0, down = 0; n < event_next && n < trace_count; ++n){
+        if(events[n].down && !down){
+            at = events[n].at;
+            from = events[n].used;
+            is_enter = events[n].keys == enter;
+        }
+        if(events[n].down)  down |= events[n].keys;
+        else                down &= ~events[n].keys;
+        if(events[n].down || down)  continue;
+        double extra =
+            events[n].used.mcu - from.mcu + events[n].used.keys - from.keys
+            - (idle.mcu + idle.keys) * (events[n].at - at) / SIM_CPU_HZ;
+        if(is_enter){
+            enter_uj += extra;
+            ++enters;
+        } else {
+            key_uj += extra;
+            ++keys;
+        }
+    }
+
+    fprintf(dest,
+        "idle      %10.2f uJ/s  mcu %.2f, display %.2f, keys %.2f"
+        " over %.3f s\n",
+        idle.mcu + idle.display + idle.keys, idle.mcu, idle.display,
+        idle.keys, (double)idle_cycles / SIM_CPU_HZ
+    );
+    fprintf(dest, "keystroke %10.2f uJ    over %zu\n",
+        keys ? key_uj / keys : 0.0, keys);
+    fprintf(dest, "compute   %10.2f uJ    over %zu\n",
+        enters ? enter_uj / enters : 0.0, enters);
+}
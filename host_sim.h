@@ -0,0 +1,229 @@
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+    // Host back end for hal.h. The firmware in main.c is compiled
+    //  unchanged with -DHOST_SIM and runs against a model of the board:
+    //  port registers, the keypad matrix and the multiplexed display.
+    //  Time is virtual. Every port access and every delay_us()/delay_ms()
+    //  advances a cycle counter, and scripted key events are applied as
+    //  the counter passes them. The serial port can be bound to a
+    //  pseudo-terminal.
+    //
+    // The whole of the model is SIM_UNIT, thread local, as is the state
+    //  of the firmware it runs (HAL_UNIT in hal.h). Each thread is a unit
+    //  with its own board, clock and trace, and starts out as after
+    //  power up. Hooks and settings such as sim_persist_us are set per
+    //  thread too.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define SIM_UNIT            _Thread_local
+
+    // Virtual time is counted in cycles of the reset default clock,
+    //  OSC8M/8, which is also the fixed clock of the timers. The CPU clock
+    //  can be raised above it with sim_clock_set().
+#define SIM_CPU_HZ          1000000u
+    // Between real time and virtual cycles
+#define US_TO_CYCLES(US)    ((uint64_t)(US) * SIM_CPU_HZ / 1000000u)
+#define CYCLES_TO_MS(C)     ((double)(C) * 1000.0 / SIM_CPU_HZ)
+
+    // Rough cost in CPU cycles of one port access, including loading the
+    //  register address. Work that does not touch the port is not charged
+    //  unless the firmware declares it through hal_work(), except that
+    //  reads nearly always sit in a polling loop, so a read is charged for
+    //  a whole loop iteration. A write is a single store to OUTSET, OUTCLR
+    //  or a configuration register; a load/modify/store of OUT costs more.
+#define SIM_CYC_PORT_WRITE  3u
+#define SIM_CYC_PORT_RMW    5u
+#define SIM_CYC_PORT_READ   20u
+    // Interrupt entry and exit plus a short handler
+#define SIM_CYC_ISR         20u
+    // A CPU clock switch: generator sync and the DFLL coming up
+#define SIM_CLOCK_SWITCH_US 8u
+    // Above SIM_FLASH_0WS_HZ the flash needs a wait state, which stalls
+    //  code run from flash by roughly SIM_FLASH_WS_PCT percent: the
+    //  Cortex-M0+ fetches a word of one or two instructions at a time and
+    //  has no cache to hide it. Code run from RAM does not stall.
+#define SIM_FLASH_0WS_HZ    24000000u
+#define SIM_FLASH_WS_PCT    40u
+
+    // A digit counts as visible if it was lit within this window, by
+    //  default; see sim_persist_us.
+#define SIM_PERSIST_US      100000u
+
+    // Keys are addressed by row*4+col, matching decode_input_type().
+    //  Chords are simply several bits at once.
+#define SIM_KEYS            16u
+
+    // Energy model. Rough typical SAMD20 supply currents at 3.3 V, running
+    //  from flash and in IDLE sleep, below and above SIM_CPU_HZ. A fast
+    //  clock costs in sleep as well, as the DFLL keeps running. A lit
+    //  segment, dot or sign draws SIM_SEG_MA for as long as its digit is
+    //  powered, scaled by the dimmer duty. A closed key on a powered row
+    //  draws SIM_KEY_MA into the column pull-down.
+#define SIM_SUPPLY_V        3.3
+#define SIM_RUN_SLOW_MA     0.40
+#define SIM_RUN_FAST_MA     3.50
+#define SIM_SLEEP_SLOW_MA   0.20
+#define SIM_SLEEP_FAST_MA   1.50
+#define SIM_SEG_MA          4.5     // (3.3 V - 1.8 V) over 330 ohm
+#define SIM_KEY_MA          0.33    // 3.3 V over 10 kohm
+
+struct sim_port_state{
+    uint32_t dir[2], out[2];
+        // PORTA pins currently handed to a peripheral (PMUXEN)
+    uint32_t pmux_a;
+    uint8_t  dim_period, dim_duty;
+};
+
+    // Energy used since sim_rewind(), in uJ
+struct sim_energy{
+    double mcu, display, keys;
+};
+
+struct sim_event{
+    uint64_t at;        // Virtual time in CPU cycles
+    uint16_t keys;      // Keys changing state
+    uint8_t  down;
+        // Energy used by the time the edge was applied
+    struct sim_energy used;
+};
+
+extern SIM_UNIT struct sim_port_state sim_port;
+extern SIM_UNIT uint64_t sim_cycles;
+    // Part of sim_cycles spent in delay_us()/delay_ms(). These waits are
+    //  busy loops on the target, but a timer could give them back.
+extern SIM_UNIT uint64_t sim_delay_cycles;
+    // Part of sim_cycles spent asleep in hal_sleep()
+extern SIM_UNIT uint64_t sim_sleep_cycles;
+    // The CPU clock, the cycles it has run, and the part of sim_cycles and
+    //  of sim_sleep_cycles spent with the clock above SIM_CPU_HZ
+extern SIM_UNIT uint32_t sim_cpu_hz;
+extern SIM_UNIT uint64_t sim_cpu_cycles;
+extern SIM_UNIT uint64_t sim_fast_cycles, sim_fast_sleep_cycles;
+    // Whether the CPU work charged from now on runs from RAM. The model
+    //  does not know which function it is in, so a tool that times one
+    //  part of the firmware sets it for the run; 0, from flash, unless
+    //  a tool says otherwise.
+extern SIM_UNIT uint8_t sim_code_in_ram;
+extern SIM_UNIT struct sim_energy sim_energy;
+    // Called whenever the visible display contents change
+extern SIM_UNIT void (*sim_display_hook)(void);
+    // Called after every timer tick the firmware takes
+extern SIM_UNIT void (*sim_tick_hook)(void);
+    // How long a digit that is no longer lit stays visible. The default
+    //  hides the slow refresh of the old blocking loops; a tool that times
+    //  changes can bring it down to one refresh of the display.
+extern SIM_UNIT uint32_t sim_persist_us;
+    // Port writes so far, and ghosting: lit states of a powered digit too
+    //  short to count as visible, whose pattern then changes while the
+    //  digit stays powered. Each shows faintly as a stray segment.
+extern SIM_UNIT uint64_t sim_port_writes;
+extern SIM_UNIT uint64_t sim_ghost_states, sim_ghost_cycles;
+
+    // Port model, called by the hal.h primitives. A write costs cycles.
+void sim_reset_port(void);
+void sim_port_changed(uint32_t cycles);
+uint32_t sim_read_in_a(void);
+int sim_running(void);
+    // Start calling the refresh timer handler every period cycles. The
+    //  handler runs between port accesses and never nests.
+void sim_tick_start(uint32_t period);
+    // Make the tick in progress last ticks periods from the last one.
+void sim_tick_stretch(uint32_t ticks);
+int sim_tick_pending(void);
+    // Timer clocks since the tick in progress began. Reading it is
+    //  charged like a port read, as it nearly always sits in a loop.
+uint32_t sim_tick_count(void);
+    // Advance to the next tick.
+void sim_sleep(void);
+    // Switch the CPU clock. Port accesses and declared work take less
+    //  time at a higher clock; delays and timers take the same.
+void sim_clock_set(uint32_t hz);
+    // Charge cycles of CPU work at the current clock
+void sim_work(uint32_t cycles);
+
+    // Serial port. Until sim_uart_open() the firmware's UART talks to
+    //  nobody. After it, the UART is carried over a pseudo-terminal whose
+    //  slave side a test script opens like any serial device; its path is
+    //  returned, or NULL on failure. The line runs at UART_BAUD in virtual
+    //  time, which is as fast as the simulation goes. Once neither side
+    //  has sent anything for SIM_UART_QUIET_US, the firmware's sleeps take
+    //  real time, so a quiet host sees timers run at their true pace. The
+    //  run lasts until the host closes the port after having written to
+    //  it.
+#define SIM_UART_QUIET_US   100000u
+const char* sim_uart_open(void);
+    // Send what is still buffered and let go of the pseudo-terminal
+void sim_uart_close(void);
+    // UART model, called by the hal.h primitives
+void sim_uart_enable(void);
+int sim_uart_rx_ready(void);
+uint8_t sim_uart_get(void);
+int sim_uart_tx_ready(void);
+void sim_uart_put(uint8_t byte);
+    // Call the UART handler whenever the transmitter is ready
+void sim_uart_tx_irq(int on);
+
+    // Flash model behind hal_nvm_*(). It erases and writes like the chip,
+    //  takes the worst case times in virtual time, and counts erases per
+    //  row. The contents outlive sim_rewind(), which is a power cycle;
+    //  sim_nvm_reset() gives a factory fresh part. sim_nvm_cut() cuts the
+    //  power during the next erase or page write, after the given number
+    //  of bytes have taken effect; the flash then ignores everything until
+    //  sim_rewind().
+#define SIM_NVM_ERASE_US    6000u
+#define SIM_NVM_WRITE_US    2500u
+extern SIM_UNIT uint32_t sim_nvm_erases[];
+void sim_nvm_reset(void);
+void sim_nvm_cut(uint32_t bytes);
+void sim_nvm_read(uint32_t offset, uint8_t* dest, uint32_t len);
+void sim_nvm_erase_row(uint32_t offset);
+void sim_nvm_write_page(uint32_t offset, const uint32_t* words);
+
+    // Stand-ins for the ASF delay service. The firmware waits on the
+    //  timer now (see sched.h); the earlier input loops transcribed in
+    //  input_bench.c still use these.
+void delay_init(void);
+void delay_us(uint32_t us);
+void delay_ms(uint32_t ms);
+
+    // Translate a key name into its keypad bits. Digits and operator
+    //  glyphs name themselves; E is Enter, D is Delete, P is the power-on
+    //  chord, Q ends the calculator, T ends the hardware test, B cycles
+    //  brightness, F is the second function prefix and S pages through
+    //  the counters. Returns 0 for an unknown name.
+uint16_t sim_key_bits(char name);
+    // Read a trace of "<time_us> <key> <1|0>" lines, one key edge per
+    //  line, sorted by time. '#' starts a comment. Returns the number of
+    //  events loaded or -1 on a malformed line.
+long sim_load_trace(FILE* src);
+    // Queue one key edge at a virtual time given in CPU cycles
+void sim_inject(uint64_t at, uint16_t keys, uint8_t down);
+    // The loaded trace, sorted by time
+const struct sim_event* sim_trace(size_t* count);
+    // Start over at time 0 with the same trace, dropping anything the
+    //  simulator injected on its own.
+void sim_rewind(void);
+    // Forget the trace and free the memory it took, for a thread that
+    //  goes on to run another unit or ends. Call sim_rewind() before
+    //  running the firmware again.
+void sim_drop_trace(void);
+    // Render the visible digits as text, most significant digit first.
+    //  A leading '-' shows the sign indicator, '.' follows a lit dot.
+void sim_render(char* dest, size_t len);
+    // Sum of the energy used so far
+double sim_energy_total(void);
+    // Break down the energy of the run over the trace. Idle is the power
+    //  drawn while no key is down, between a release and the next press.
+    //  A keystroke is the MCU and keypad energy from a press to its
+    //  release, less their idle power over that time; the display draws
+    //  by what it shows, keys or not, and is left out. Enter presses,
+    //  which start a compute, are reported apart from the other keys.
+void sim_energy_report(FILE* dest);
+
+int firmware_main(void);
+
+#endif
@@ -0,0 +1,169 @@
+    // Display current and wake latency of the inactivity stages of the
+    //  calculator, run on the host simulator.
+    //
+    //  Build:  cc -DHOST_SIM -O2 -o idle_bench
+    //              idle_bench.c host_sim.c main.c sched.c serial.c
+    //              clock.c persist.c trace.c
+    //  Usage:  idle_bench
+    //
+    // The whole firmware runs one session with short inactivity times:
+    //  12+34E, left alone until the display dims, a key to wake it, left
+    //  alone until it goes dark, a key to wake it, then left alone until
+    //  it shuts itself down.
+    //
+    // Reported:
+    //  - mean display current in each stage, over a few seconds well
+    //    inside it, and against the display awake
+    //  - wake latency: from the down edge of the waking key until the
+    //    display draws at least WAKE_FULL of its current awake, and what
+    //    it shows then. The waking key should not have been taken.
+
+#include "hal.h"
+
+#include <stdlib.h>
+
+    // Inactivity times for the run, in ms
+#define BENCH_DIM_MS        5000u
+#define BENCH_BLANK_MS      10000u
+#define BENCH_OFF_MS        20000u
+#define BENCH_START_US      2000000u
+#define BENCH_HOLD_US       80000u
+#define BENCH_GAP_US        220000u
+    // Margin kept from either end of a stage when taking its current
+#define MARGIN_US           1000000u
+    // Past the shutdown animation
+#define SHUT_US             3000000u
+    // Four ticks light every digit once
+#define WINDOW_TICKS        4u
+#define WAKE_FULL           0.9
+#define MAX_SAMPLES         200000u
+    // When the display is read after a waking key
+#define SHOW_AFTER_US       300000u
+#define WAKES               2u
+
+#define MS_TO_CYCLES(MS)    US_TO_CYCLES((uint64_t)(MS) * 1000u)
+
+    // From main.c
+void idle_timeouts(uint32_t dim_ms, uint32_t blank_ms, uint32_t off_ms);
+
+struct sample{
+    uint64_t at;
+    double display;
+};
+
+struct stage{
+    const char* name;
+    uint64_t from, to;
+};
+
+static struct sample samples[MAX_SAMPLES];
+static size_t sample_count;
+static uint64_t show_at[WAKES];
+static char shown[WAKES][16];
+
+static void record_tick(void){
+    size_t n = 0;
+    for(; n < WAKES; ++n){
+        if(!shown[n][0] && sim_cycles >= show_at[n])
+            sim_render(shown[n], sizeof(shown[n]));
+    }
+    if(sample_count == MAX_SAMPLES) return;
+    samples[sample_count].at = sim_cycles;
+    samples[sample_count].display = sim_energy.display;
+    ++sample_count;
+}
+
+    // First sample at or after a time
+static size_t sample_at(uint64_t at){
+    size_t n = 0;
+    for(; n + 1u < sample_count && samples[n].at < at; ++n);
+    return n;
+}
+
+    // Mean display current between two samples, in mA
+static double current(size_t from, size_t to){
+    uint64_t took = samples[to].at - samples[from].at;
+    if(!took)   return 0.0;
+        // uJ / (V * ms) comes out in mA
+    return (samples[to].display - samples[from].display)
+        / (SIM_SUPPLY_V * CYCLES_TO_MS(took));
+}
+
+static void press(uint64_t* at, char name){
+    sim_inject(*at, sim_key_bits(name), 1);
+    *at += US_TO_CYCLES(BENCH_HOLD_US);
+    sim_inject(*at, sim_key_bits(name), 0);
+    *at += US_TO_CYCLES(BENCH_GAP_US);
+}
+
+    // Wake latency of the key pressed at, and the display a little later
+static void report_wake(
+    const char* name, uint64_t at, const char* text, double awake
+){
+    size_t n = sample_at(at);
+    for(; n + WINDOW_TICKS < sample_count; ++n){
+        if(current(n, n + WINDOW_TICKS) >= WAKE_FULL * awake)   break;
+    }
+    if(n + WINDOW_TICKS >= sample_count){
+        printf("wake from %-6s    never\n", name);
+        return;
+    }
+    printf(
+        "wake from %-6s %8.2f ms  [%s]\n", name,
+        CYCLES_TO_MS(samples[n + WINDOW_TICKS].at - at), text
+    );
+}
+
+int main(void){
+    static const char keys[] = "12+34E";
+    uint64_t at = US_TO_CYCLES(BENCH_START_US), enter = 0, wake_dim = 0;
+    uint64_t wake_blank = 0;
+    const char* key = keys;
+    for(; *key; ++key){
+        enter = at;
+        press(&at, *key);
+    }
+    wake_dim = enter + MS_TO_CYCLES(BENCH_DIM_MS + BENCH_BLANK_MS) / 2u;
+    at = wake_dim;
+    press(&at, '7');
+    wake_blank = wake_dim + MS_TO_CYCLES(BENCH_BLANK_MS + BENCH_OFF_MS) / 2u;
+    at = wake_blank;
+    press(&at, '8');
+        // A key while off does nothing, but keeps the run going
+    at = wake_blank + MS_TO_CYCLES(BENCH_OFF_MS)
+        + US_TO_CYCLES(SHUT_US + 3u * MARGIN_US);
+    press(&at, '9');
+
+    const struct stage stages[] = {
+        {"awake",   enter, enter + MS_TO_CYCLES(BENCH_DIM_MS)},
+        {"dim",     enter + MS_TO_CYCLES(BENCH_DIM_MS), wake_dim},
+        {"blank",   wake_dim + MS_TO_CYCLES(BENCH_BLANK_MS), wake_blank},
+        {"off",
+            wake_blank + MS_TO_CYCLES(BENCH_OFF_MS) + US_TO_CYCLES(SHUT_US), at},
+    };
+
+    sim_rewind();
+    sample_count = 0;
+    show_at[0] = wake_dim + US_TO_CYCLES(SHOW_AFTER_US);
+    show_at[1] = wake_blank + US_TO_CYCLES(SHOW_AFTER_US);
+    idle_timeouts(BENCH_DIM_MS, BENCH_BLANK_MS, BENCH_OFF_MS);
+    sim_tick_hook = record_tick;
+    firmware_main();
+    sim_tick_hook = NULL;
+
+    printf("%-8s %10s %8s\n", "stage", "display_mA", "vs_awake");
+    size_t n = 0;
+    double awake = 0.0;
+    for(; n < sizeof(stages) / sizeof(stages[0]); ++n){
+        double ma = current(
+            sample_at(stages[n].from + US_TO_CYCLES(MARGIN_US)),
+            sample_at(stages[n].to - US_TO_CYCLES(MARGIN_US))
+        );
+        if(n == 0u) awake = ma;
+        printf("%-8s %10.3f %7.1f%%\n", stages[n].name, ma,
+            awake > 0.0 ? 100.0 * ma / awake : 0.0);
+    }
+    report_wake("dim", wake_dim, shown[0], awake);
+    report_wake("blank", wake_blank, shown[1], awake);
+    return 0;
+}
@@ -0,0 +1,327 @@
+    // Side-by-side benchmark of the keypad input pipelines of the
+    //  firmware variants, run on the host simulator.
+    //
+    //  Build:  cc -DHOST_SIM -O2 -o input_bench
+    //              input_bench.c host_sim.c main.c sched.c serial.c
+    //              clock.c persist.c trace.c
+    //  Usage:  input_bench [trace_file]    replay a recorded trace
+    //          input_bench -g [seed]       print the built-in trace
+    //
+    // Without a file, a synthetic trace of single key presses with contact
+    //  bounce on both edges is generated from a fixed seed, so runs are
+    //  comparable. Every variant sees exactly the same key edges.
+    //
+    // main_v1.c and main_v2_(no_debounce).c are kept as historical
+    //  snapshots and no longer build against hal.h, so their scan loops are
+    //  transcribed below with the delays they used. The main.c pipelines are
+    //  linked from main.c: "blocking" is check_key()/debounce_keypress()
+    //  as still used by the hardware test, "main" is the scan task that
+    //  the calculator runs under the scheduler.
+    //
+    // Reported per variant:
+    //  - latency from the first press edge until the key's glyph has been
+    //    written to the display
+    //  - presses missed, duplicated, or reported as the wrong key
+    //  - CPU busy time: cycles spent polling, excluding delay_us/delay_ms
+    //    waits that a timer could take over and time asleep
+
+#include "hal.h"
+#include "sched.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_KEYS          200u
+#define BENCH_SEED          0x2545F491u
+    // A key has to stay released this long before its next down edge
+    //  counts as a new press rather than bounce.
+#define SETTLE_US           20000u
+#define MAX_REPORTS         8192u
+
+    // From main.c
+void check_key(uint8_t* row_dest, uint8_t* col_dest);
+void display_dig(
+    uint32_t add_delay, uint8_t dig_to_display, uint8_t select,
+    uint8_t show_dot, uint8_t show_sign
+);
+uint32_t find_lsob(uint32_t);
+void configure_ports(void);
+void set_initial_state(void);
+void configure_tasks(void);
+void start_io_tasks(void);
+uint8_t pop_key(uint8_t* row, uint8_t* col);
+
+    // One pass of a variant's main loop: scan for keys and keep the
+    //  display refreshed the way that variant did. Returns non-zero with
+    //  the row and the raw column bits when a key was seen.
+struct input_pipeline{
+    const char* name;
+    void (*reset)(void);
+    uint8_t (*poll)(uint8_t* row, uint8_t* col);
+};
+
+struct press{
+    uint64_t at;
+    uint8_t  key;
+};
+
+struct report{
+    uint64_t shown;     // Glyph written to the display
+    uint8_t  key;
+};
+
+static uint8_t scan_row;
+static struct report reports[MAX_REPORTS];
+static size_t report_count;
+
+    /**********   Start variants   **********/
+static void reset_scan(void){
+    scan_row = 0u;
+}
+
+    // main_v1.c: wait_for_key(1, ...) as used by its test_hardware().
+    //  Polls row after row, lighting each digit for 4 ms, until any column
+    //  reads high. No debouncing; waits 1 ms after a hit.
+static uint8_t v1_poll(uint8_t* row, uint8_t* col){
+#define V1_DELAY_MS 1u
+    for(;;){
+        hal_seg_blank();
+        hal_row_drive(scan_row);
+        *col = hal_key_cols();
+        *row = scan_row;
+        display_dig(V1_DELAY_MS * 4u * 1000u, 8u, *row, 0, 0);
+        if(*col){
+            if(*col != 0xB && *col != 0xD)  delay_ms(V1_DELAY_MS);
+            return 1;
+        }
+        scan_row = (scan_row + 1u) % 4u;
+    }
+#undef V1_DELAY_MS
+}
+
+    // main_v2_(no_debounce).c: check_key() reads the columns once per row
+    //  and run_calculator() lights the digit for 3 ms, then blanks the
+    //  opposite one for 1 ms (its display_dig() delays in milliseconds).
+static uint8_t v2_poll(uint8_t* row, uint8_t* col){
+    hal_row_drive(scan_row);
+    *col = hal_key_cols();
+    *row = scan_row;
+    scan_row = (scan_row + 1u) % 4u;
+    display_dig(3000u, 8u, *row, 0, 0);
+    display_dig(1000u, 0xFF, 3u - *row, 0, 0);
+    return *col != 0;
+}
+
+    // main.c: check_key() with debounce_keypress(), and the 200 us digit
+    //  and 1 us blank that run_calculator() used before the scheduler.
+static uint8_t blocking_poll(uint8_t* row, uint8_t* col){
+    check_key(row, col);
+    display_dig(200u, 8u, *row, 0, 0);
+    display_dig(1u, 0xFF, 3u - *row, 0, 0);
+    return *col != 0;
+}
+
+    // main.c: scan_task() and display_task() under the scheduler. Each
+    //  step runs whatever is due or sleeps until it is.
+static void reset_tasks(void){
+    configure_tasks();
+    start_io_tasks();
+}
+
+static uint8_t main_poll(uint8_t* row, uint8_t* col){
+    sched_step();
+    return pop_key(row, col);
+}
+
+static const struct input_pipeline pipelines[] = {
+    {"main_v1",     reset_scan, v1_poll},
+    {"main_v2",     reset_scan, v2_poll},
+    {"blocking",    reset_scan, blocking_poll},
+    {"main",        reset_tasks, main_poll},
+};
+    /**********   End variants     **********/
+
+static uint32_t rng_state;
+static uint32_t rng_next(uint32_t bound){
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state % bound;
+}
+
+    // Contact bounce: a few short toggles ending in the settled state
+static void inject_bounce(uint64_t* at, uint16_t bits, uint8_t down){
+    uint32_t toggles = rng_next(5u);
+    for(; toggles > 0u; --toggles){
+        sim_inject(*at, bits, down);
+        *at += US_TO_CYCLES(100u + rng_next(900u));
+        sim_inject(*at, bits, !down);
+        *at += US_TO_CYCLES(100u + rng_next(900u));
+    }
+    sim_inject(*at, bits, down);
+}
+
+static void generate_trace(uint32_t seed){
+    static const char names[] = "0123456789+-*/ED";
+    uint64_t at = US_TO_CYCLES(200000u);
+    uint32_t n = 0;
+    rng_state = seed ? seed : BENCH_SEED;
+    for(; n < BENCH_KEYS; ++n){
+        uint16_t bits = sim_key_bits(names[rng_next(sizeof(names) - 1u)]);
+        inject_bounce(&at, bits, 1);
+        at += US_TO_CYCLES(60000u + rng_next(140000u));
+        inject_bounce(&at, bits, 0);
+        at += US_TO_CYCLES(150000u + rng_next(250000u));
+    }
+}
+
+    // Single key presses in the trace, with bounce folded away
+static size_t extract_presses(struct press** dest){
+    size_t count = 0, n = 0, out = 0;
+    const struct sim_event* ev = sim_trace(&count);
+    uint64_t released[SIM_KEYS] = {0};
+    uint16_t down = 0;
+    *dest = malloc((count + 1u) * sizeof(**dest));
+    if(*dest == NULL)   return 0;
+    for(; n < count; ++n){
+        uint8_t key = 0;
+        for(; key < SIM_KEYS; ++key){
+            uint16_t bit = 1u << key;
+            if(!(ev[n].keys & bit)) continue;
+            if(ev[n].down && !(down & bit)){
+                if(!released[key]
+                    || ev[n].at - released[key] >= US_TO_CYCLES(SETTLE_US)
+                ){
+                    (*dest)[out].at = ev[n].at;
+                    (*dest)[out].key = key;
+                    ++out;
+                }
+                down |= bit;
+            } else if(!ev[n].down && (down & bit)){
+                released[key] = ev[n].at;
+                down &= ~bit;
+            }
+        }
+    }
+    return out;
+}
+
+static int compare_u64(const void* a, const void* b){
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void run_pipeline(
+    const struct input_pipeline* p, const struct press* presses, size_t count
+){
+    sim_rewind();
+    configure_ports();
+    set_initial_state();
+    p->reset();
+    report_count = 0;
+
+    uint64_t busy = 0;
+    uint8_t row = 0, col = 0;
+    while(sim_running()){
+        uint64_t start = sim_cycles, waited = sim_delay_cycles;
+        uint64_t slept = sim_sleep_cycles;
+        uint8_t hit = p->poll(&row, &col);
+        busy += (sim_cycles - start) - (sim_delay_cycles - waited)
+            - (sim_sleep_cycles - slept);
+        if(!hit)    continue;
+        if(row == 3u && (col == 0xB || col == 0xD)) break;
+
+        uint8_t key = row * 4u + find_lsob(col);
+        display_dig(0u, key, row, 0, 0);
+        if(report_count < MAX_REPORTS){
+            reports[report_count].shown = sim_cycles;
+            reports[report_count].key = key;
+            ++report_count;
+        }
+    }
+
+        // Walk the presses and the reports together. Each press owns the
+        //  reports made before the next press.
+    uint64_t* latency = malloc((count + 1u) * sizeof(*latency));
+    size_t missed = 0, dup = 0, wrong = 0, hits = 0, r = 0, n = 0;
+    for(; n < count; ++n){
+        uint64_t until = n + 1u < count ? presses[n+1].at : UINT64_MAX;
+        size_t matched = 0;
+        for(; r < report_count && reports[r].shown < presses[n].at; ++r)
+            ++wrong;    // Reported with no press behind it
+        for(; r < report_count && reports[r].shown < until; ++r){
+            if(reports[r].key != presses[n].key){
+                ++wrong;
+            } else if(matched++ == 0 && latency){
+                latency[hits++] = reports[r].shown - presses[n].at;
+            }
+        }
+        if(matched == 0)    ++missed;
+        else                dup += matched - 1u;
+    }
+    wrong += report_count - r;
+
+    double mean = 0.0;
+    uint64_t max = 0;
+    if(hits && latency){
+        size_t k = 0;
+        qsort(latency, hits, sizeof(*latency), compare_u64);
+        for(; k < hits; ++k)    mean += latency[k];
+        mean /= hits;
+        max = latency[hits-1];
+    }
+    printf(
+        "%-10s %8.2f %8.2f %8.2f %7zu %7zu %7zu %7.1f%%\n",
+        p->name,
+        CYCLES_TO_MS(mean),
+        hits && latency ? CYCLES_TO_MS(latency[hits/2]) : 0.0,
+        CYCLES_TO_MS(max),
+        missed, dup, wrong,
+        sim_cycles ? 100.0 * busy / sim_cycles : 0.0
+    );
+    free(latency);
+}
+
+int main(int argc, char* argv[]){
+    if(argc > 1 && strcmp(argv[1], "-g") == 0){
+        generate_trace(argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 0u);
+        size_t count = 0, n = 0;
+        const struct sim_event* ev = sim_trace(&count);
+        for(; n < count; ++n){
+            uint8_t key = find_lsob(ev[n].keys);
+            printf(
+                "%llu %c %u\n",
+                (unsigned long long)(ev[n].at * 1000000u / SIM_CPU_HZ),
+                "/+0-*987D654E321"[key], ev[n].down
+            );
+        }
+        return 0;
+    }
+
+    if(argc > 1){
+        FILE* src = fopen(argv[1], "r");
+        if(src == NULL || sim_load_trace(src) < 0){
+            fprintf(stderr, "%s: cannot read trace %s\n", argv[0], argv[1]);
+            return 1;
+        }
+        fclose(src);
+    } else {
+        generate_trace(0u);
+    }
+
+    struct press* presses = NULL;
+    size_t count = extract_presses(&presses);
+    printf("%zu presses\n", count);
+    printf(
+        "%-10s %8s %8s %8s %7s %7s %7s %8s\n",
+        "variant", "mean_ms", "p50_ms", "max_ms",
+        "missed", "dup", "wrong", "busy"
+    );
+
+    size_t n = 0;
+    for(; n < sizeof(pipelines) / sizeof(pipelines[0]); ++n)
+        run_pipeline(&pipelines[n], presses, count);
+
+    free(presses);
+    return 0;
+}
@@ -0,0 +1,227 @@
+    // Key to display latency of the calculator, with percentiles and a
+    //  budget, run on the host simulator.
+    //
+    //  Build:  cc -DHOST_SIM -O2 -o latency_bench
+    //              latency_bench.c host_sim.c main.c sched.c serial.c
+    //              clock.c persist.c trace.c
+    //  Usage:  latency_bench [keys [seed]]
+    //
+    // The whole firmware runs a random session from the seed: expressions
+    //  of two operands, with now and then a digit deleted and keyed again,
+    //  each ended by Enter. Presses come at random times to the
+    //  microsecond, so they land at every point of the keypad scan and the
+    //  display refresh, and both edges bounce as in input_bench. Operands
+    //  are kept short enough that every result fits the display, so no
+    //  page change of a wide result is taken for a key's.
+    //
+    // The latency of a press runs from its first down edge until the
+    //  segments on show next change, the debounce included. A digit that
+    //  goes dark counts as changed once it has missed a refresh. A press
+    //  whose change does not come before the next press, such as 1*1
+    //  showing 1 again, is counted apart and not timed.
+    //
+    // Percentiles are reported over all keys and by keypad row. The run
+    //  fails, with exit status 1, when p99 or max is over its budget.
+
+#include "hal.h"
+
+#include <stdlib.h>
+
+#define BENCH_KEYS          5000u
+#define BENCH_SEED          0x2545F491u
+    // Past the power-on blink
+#define BENCH_START_US      2000000u
+    // Budgets, in microseconds
+#ifndef BUDGET_P99_US
+#define BUDGET_P99_US       30000u
+#endif
+#ifndef BUDGET_MAX_US
+#define BUDGET_MAX_US       50000u
+#endif
+#define KEY_ROWS            4u
+    // All four digits are lit once every 4 ms
+#define REFRESH_US          5000u
+    // Most presses one expression takes: two operands of four digits,
+    //  three of them keyed twice around a delete, the operator and Enter
+#define EXPR_PRESSES        16u
+
+    // From main.c
+uint32_t find_lsob(uint32_t);
+
+struct press{
+    uint64_t at;
+    uint8_t  row;
+};
+
+static struct press* presses;
+static size_t press_count, press_max;
+static uint64_t* changes;
+static size_t change_count, change_max;
+
+static void record_change(void){
+    if(change_count < change_max)   changes[change_count++] = sim_cycles;
+}
+
+static uint32_t rng_state;
+static uint32_t rng_next(uint32_t bound){
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state % bound;
+}
+
+    // Contact bounce: a few short toggles ending in the settled state
+static void inject_bounce(uint64_t* at, uint16_t bits, uint8_t down){
+    uint32_t toggles = rng_next(5u);
+    for(; toggles > 0u; --toggles){
+        sim_inject(*at, bits, down);
+        *at += US_TO_CYCLES(100u + rng_next(900u));
+        sim_inject(*at, bits, !down);
+        *at += US_TO_CYCLES(100u + rng_next(900u));
+    }
+    sim_inject(*at, bits, down);
+}
+
+static void press(uint64_t* at, char name){
+    uint16_t bits = sim_key_bits(name);
+    if(press_count < press_max){
+        presses[press_count].at = *at;
+        presses[press_count].row = find_lsob(bits) / 4u;
+        ++press_count;
+    }
+    inject_bounce(at, bits, 1);
+        // Held well short of the auto-repeat
+    *at += US_TO_CYCLES(40000u + rng_next(160000u));
+    inject_bounce(at, bits, 0);
+    *at += US_TO_CYCLES(80000u + rng_next(320000u));
+}
+
+static void press_operand(uint64_t* at, uint32_t digits){
+    press(at, (char)('1' + rng_next(9u)));
+    while(--digits){
+        if(rng_next(8u) == 0u){
+            press(at, (char)('0' + rng_next(10u)));
+            press(at, 'D');
+        }
+        press(at, (char)('0' + rng_next(10u)));
+    }
+}
+
+static void generate_trace(uint32_t keys){
+    static const char ops[] = "+-*/";
+    uint64_t at = US_TO_CYCLES(BENCH_START_US);
+    press_count = 0;
+    while(press_count < keys){
+        char op = ops[rng_next(4u)];
+            // Products of up to four digits in all, sums of up to three
+            //  digit operands
+        uint32_t left = 1u + rng_next(op == '*' ? 3u : op == '+' ? 3u : 4u);
+        uint32_t right =
+            1u + rng_next(op == '*' ? 4u - left : op == '+' ? 3u : 4u);
+        press_operand(&at, left);
+        press(&at, op);
+        press_operand(&at, right);
+        press(&at, 'E');
+    }
+}
+
+static int compare_u64(const void* a, const void* b){
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+    // Nearest rank percentile of sorted values
+static uint64_t percentile(const uint64_t* sorted, size_t count, uint32_t p){
+    size_t rank = (count * p + 99u) / 100u;
+    return count ? sorted[rank ? rank - 1u : 0u] : 0u;
+}
+
+static void print_row(const char* name, uint64_t* latency, size_t count){
+    qsort(latency, count, sizeof(*latency), compare_u64);
+    printf(
+        "%-6s %7zu %8.2f %8.2f %8.2f %8.2f\n",
+        name, count,
+        CYCLES_TO_MS(percentile(latency, count, 50u)),
+        CYCLES_TO_MS(percentile(latency, count, 95u)),
+        CYCLES_TO_MS(percentile(latency, count, 99u)),
+        CYCLES_TO_MS(count ? latency[count-1] : 0u)
+    );
+}
+
+int main(int argc, char* argv[]){
+    uint32_t keys = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 0u;
+    uint32_t seed = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 0u;
+    uint64_t* latency = NULL;
+    uint64_t* by_row[KEY_ROWS] = {NULL};
+    size_t row_count[KEY_ROWS] = {0};
+    size_t timed = 0, unchanged = 0, n = 0, c = 0;
+    uint8_t row = 0;
+    if(keys == 0u)  keys = BENCH_KEYS;
+    rng_state = seed ? seed : BENCH_SEED;
+
+        // The last expression may run past keys
+    press_max = keys + EXPR_PRESSES;
+    change_max = 4u * press_max;
+    presses = malloc(press_max * sizeof(*presses));
+    changes = malloc(change_max * sizeof(*changes));
+    latency = malloc(press_max * sizeof(*latency));
+    for(; row < KEY_ROWS; ++row){
+        by_row[row] = malloc(press_max * sizeof(*by_row[row]));
+        if(by_row[row] == NULL) presses = NULL;
+    }
+    if(presses == NULL || changes == NULL || latency == NULL){
+        fprintf(stderr, "%s: out of memory\n", argv[0]);
+        return 1;
+    }
+    generate_trace(keys);
+
+    sim_rewind();
+    sim_persist_us = REFRESH_US;
+    sim_display_hook = record_change;
+    firmware_main();
+    sim_display_hook = NULL;
+
+        // Each press owns the first display change before the next one
+    for(; n < press_count; ++n){
+        uint64_t until = n + 1u < press_count ? presses[n+1].at : UINT64_MAX;
+        uint64_t took = 0;
+        for(; c < change_count && changes[c] <= presses[n].at; ++c);
+        if(c == change_count || changes[c] >= until){
+            ++unchanged;
+            continue;
+        }
+        took = changes[c] - presses[n].at;
+        latency[timed++] = took;
+        by_row[presses[n].row][row_count[presses[n].row]++] = took;
+    }
+
+    printf("%zu presses, %zu timed, %zu unchanged\n", press_count, timed,
+        unchanged);
+    printf(
+        "%-6s %7s %8s %8s %8s %8s\n",
+        "keys", "count", "p50_ms", "p95_ms", "p99_ms", "max_ms"
+    );
+    for(row = 0; row < KEY_ROWS; ++row){
+        char name[8] = "row 0";
+        name[4] = (char)('0' + row);
+        print_row(name, by_row[row], row_count[row]);
+    }
+    print_row("all", latency, timed);
+
+    uint64_t p99 = percentile(latency, timed, 99u);
+    uint64_t max = timed ? latency[timed-1] : 0u;
+    int over = p99 > US_TO_CYCLES(BUDGET_P99_US)
+        || max > US_TO_CYCLES(BUDGET_MAX_US);
+    printf(
+        "budget p99 %.2f ms, max %.2f ms: %s\n",
+        CYCLES_TO_MS(US_TO_CYCLES(BUDGET_P99_US)),
+        CYCLES_TO_MS(US_TO_CYCLES(BUDGET_MAX_US)),
+        over ? "OVER" : "ok"
+    );
+
+    for(row = 0; row < KEY_ROWS; ++row) free(by_row[row]);
+    free(latency);
+    free(changes);
+    free(presses);
+    return over;
+}
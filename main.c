@@ -1,8 +1,18 @@
-#include <asf.h>
+#include "clock.h"
+#include "hal.h"
+#include "persist.h"
+#include "sched.h"
+#include "serial.h"
+#include "trace.h"
 
     /**********   Start Macro switches   **********/
 //#define RUN_CHECK
 //#define RUN_SOFT_CHECK
+//#define RUN_BENCH
+    // HOST_SIM (normally given on the compiler command line) builds
+    //  against the host simulator instead of the SAMD20; see hal.h.
+    //  EVENT_TRACE, given the same way, builds in the event trace of
+    //  trace.h, read with the r serial command.
     /**********   End Macro switches    **********/
 
     /**********   Start Macro defines   **********/
@@ -20,6 +30,161 @@
 #define SUB_GLYPH           '-'
 #define MUL_GLYPH           '*'
 #define DIV_GLYPH           '/'
+    // Bitwise operations of programmer mode. They are reached through the
+    //  FN prefix (keys 0 and 3 together), which gives the next key its
+    //  second meaning:
+    //    +  --> OR       *  --> AND      -  --> XOR
+    //    /  --> SHL      Delete --> SHR
+    //    1 - 6 --> A - F   Enter --> next radix
+    //    0, 7, 8 --> statistics, see SIGMA_ADD
+#define AND_GLYPH           '&'
+#define OR_GLYPH            '|'
+#define XOR_GLYPH           '^'
+#define SHL_GLYPH           '<'
+#define SHR_GLYPH           '>'
+
+    // Statistics over values keyed one at a time, run by FN and a digit:
+    //    0 --> add the value on show, then show the count
+    //    7 --> show the next statistic: count, sum, mean, variance,
+    //          lowest, highest, then the count again
+    //    8 --> clear, showing the count
+    //  Each is shown as a result, so it can be carried into an expression.
+    //  Adding a value takes the same few steps however many came before:
+    //  the count, the sum and the sum of squares are exact integers, so
+    //  nothing is lost however large they grow and nothing cancels, and
+    //  only showing the mean or variance divides, rounding to the nearest.
+    //  The variance is that of a sample, over count - 1. Values must be
+    //  within SIGMA_LIMIT and at most SIGMA_COUNT_MAX of them go in, which
+    //  keeps the sum within 63 bits and the sum of squares within 96. The
+    //  statistics are in RAM and outlast turning the calculator off, but
+    //  not a power loss.
+#define SIGMA_ADD           0x0u
+#define SIGMA_NEXT          0x7u
+#define SIGMA_CLEAR         0x8u
+#define SIGMA_LIMIT         0x7FFFFFFF
+#define SIGMA_COUNT_MAX     0x7FFFFFFFu
+    // Statistics in the order SIGMA_NEXT steps through them
+#define SIGMA_N             0u
+#define SIGMA_SUM           1u
+#define SIGMA_MEAN          2u
+#define SIGMA_VAR           3u
+#define SIGMA_LOW           4u
+#define SIGMA_HIGH          5u
+#define SIGMA_STATS         6u
+
+    // Radices in the order the FN + Enter key cycles through them.
+#define RADIX_COUNT         4u
+
+    // Display dimming. The PWM itself lives in hal.h; these are the
+    //  user-selectable steps on top of it.
+#define DIM_LEVELS          4u
+
+    // Results are kept at full width, up to 63 binary digits. When a result
+    //  is wider than the display it is shown MAX_DIGITS digits at a time,
+    //  most significant window first, moving on every PAGE_MS. The dots
+    //  show the window number in binary, counting from 1 at the least
+    //  significant window. Enter steps to the next window at once.
+#define RESULT_DIGITS       63u
+#define PAGE_MS             1000u
+
+    // Largest magnitude the wide arithmetic path keeps. It is symmetric
+    //  so that every result can be negated.
+#define WIDE_MAX            0x7FFFFFFFFFFFFFFFull
+    // Shown alone on the leftmost digit after an overload
+#define ERROR_DIG           0xEu
+
+    // Task timing, in milliseconds. One keypad row is scanned and one digit
+    //  lit per millisecond, so keypad and display both cycle every 4 ms.
+#define SCAN_PERIOD_MS      1u
+#define DISPLAY_PERIOD_MS   1u
+#define CALC_DEADLINE_MS    5u
+#define ANIM_DEADLINE_MS    5u
+    // A row has to read the same this many scans running before it counts
+#define DEBOUNCE_SCANS      3u
+    // Key presses waiting for the calculator task. A power of two.
+#define KEY_QUEUE_LEN       8u
+    // Auto-repeat of a lone digit or delete key held down: the first
+    //  repeat after REPEAT_DELAY_MS, the next REPEAT_START_MS later, and
+    //  each gap after that REPEAT_STEP_MS shorter down to REPEAT_MIN_MS.
+    //  Rows are scanned every MAX_DIGITS ms, which is the finest step.
+    //  A delay of 0 turns repeating off.
+#define REPEAT_DELAY_MS     500u
+#define REPEAT_START_MS     200u
+#define REPEAT_STEP_MS      25u
+#define REPEAT_MIN_MS       50u
+    // Column bit set on a queued press that is a repeat
+#define KEY_REPEAT          0x80u
+    // Rough M0+ cycles spent handling one key, and on top of that in one
+    //  compute(), mostly in the division kernels. The calculator task runs
+    //  on the burst clock (see clock.h). The simulator only sees port
+    //  accesses, so these are charged to it through hal_work().
+#define KEY_WORK_CYCLES     300u
+#define COMPUTE_WORK_CYCLES 2500u
+    // Counters of what the calculator has been doing since reset, all
+    //  32 bits and wrapping. An update is one increment at a fixed address.
+    //  The stats chord (keys 12 and 15) shows them one at a time: the dots
+    //  give the counter number in binary and the value is shown in hex,
+    //  low half then high half with the sign lit, alternating every
+    //  PAGE_MS. Pressing the chord again moves to the next counter; any
+    //  other key leaves.
+#define PERF_KEYS           0u  // Key presses, one counter per INPUT_TYPE
+#define PERF_REJECTS        10u // Readings that changed before settling
+#define PERF_REPEATS        11u // Presses repeated by a key held down
+#define PERF_COMPUTES       12u
+#define PERF_OVERFLOWS      13u
+#define PERF_LOOP_RATE      14u // Scheduler passes in the last second
+#define PERF_COUNT          15u
+#define PERF_PERIOD_MS      1000u
+
+    // How often the power-on chord is checked while off
+#define POWER_POLL_MS       20u
+
+    // The calculator and its settings are saved to flash (see persist.h)
+    //  once the keys have been left alone for SAVE_DELAY_MS, and on the
+    //  termination chord, and read back at power-on. A run of keys costs
+    //  one write, and none if it changed nothing. A save that erases a row
+    //  stalls the CPU for up to 8.5 ms. Bump SAVE_VERSION when saved_state
+    //  changes.
+#define SAVE_DELAY_MS       2000u
+#define SAVE_DEADLINE_MS    10u
+#define SAVE_VERSION        1u
+
+    // Inactivity. With no key for IDLE_DIM_MS the display drops to
+    //  IDLE_DIM_DUTY, after IDLE_BLANK_MS it goes dark, and after
+    //  IDLE_OFF_MS the calculator shuts down as on the termination chord,
+    //  saving first. Times count from the last key; 0 leaves a stage out.
+    //  The first key on a dimmed or dark display only brings it back and
+    //  is not taken as input. idle_timeouts() changes the times.
+#define IDLE_DIM_MS         30000u
+#define IDLE_BLANK_MS       120000u
+#define IDLE_OFF_MS         600000u
+#define IDLE_DIM_DUTY       0x01u
+#define IDLE_DEADLINE_MS    5u
+#define IDLE_AWAKE          0u
+#define IDLE_DIM            1u
+#define IDLE_BLANK          2u
+#define IDLE_OFF            3u
+
+    // Serial commands. The receive ring holds a whole command line, so a
+    //  host that waits for each reply never loses a byte.
+#define SERIAL_PERIOD_MS    2u
+#define CMD_LEN             SERIAL_RX_LEN   // Longest command line
+#define REPLY_LEN           192u            // Longest reply, with newline
+#define TRACE_PER_REPLY     10u             // Trace records in one r reply
+
+    // Animations, run as a task one frame at a time alongside the others
+#define ANIM_BOOT           1u  // Ready blink while the calculator runs
+#define ANIM_SHUT           2u  // "1337", then the ready and sign blink
+#define ANIM_BLINK          3u  // Ready and sign blink alone
+    // Animation lengths. Setting a count to 0 leaves that part out. An
+    //  animation is at most 255 frames.
+#define BOOT_BLINKS         3u
+#define BOOT_BLINK_MS       250u
+#define SHUT_PASSES         7u  // Times the banner is drawn on each digit
+#define SHUT_FRAME_MS       5u
+#define SHUT_BLINKS         3u
+#define SHUT_BLINK_MS       333u
+#define CHECK_BLINKS        3u  // blink_rdy() in the hardware test
 
     // Short macro functions for inlining common expressions
 #define IS_NULL(P) (P == NULL)
@@ -30,6 +195,8 @@
 
 #define INT32   int32_t
 #define UINT32  uint32_t
+#define INT64   int64_t
+#define UINT64  uint64_t
 #define UINT8   uint8_t
 
 #define STATE_TYPE      UINT8
@@ -43,6 +210,11 @@
 #define ENT_INPUT       2u
 #define NO_INPUT        3u
 #define DEL_INPUT       4u
+#define BRIGHT_INPUT    5u
+#define FN_INPUT        6u
+#define RADIX_INPUT     7u
+#define STATS_INPUT     8u
+#define SIGMA_INPUT     9u
 #define TERM_INPUT      16u
 
 #define BOOLEAN__     UINT8
@@ -50,6 +222,8 @@
 #define FALSE__       0
 
 #define NULL_DIG 255
+    // Shown blank like NULL_DIG, but keeps its dot
+#define BLANK_DIG 254
 
 typedef struct {
         // Store both operands as four digit numbers in an array. The operands
@@ -69,6 +243,44 @@ struct calculator_information_packet{
     expression_data exp;
     UINT8 magnitude, num_to_display;
     STATE_TYPE state;
+        // Entry and display radix. Shift is log2 of the radix for the
+        //  powers of two and unused for decimal. Kept across calculations.
+    UINT8 radix, radix_shift, radix_sel;
+        // Magnitude of the last result and its digits, least significant
+        //  first. The sign is kept in bit 0 of exp.is_neg like operand 1.
+        //  Operand 1 holds the low digits for display and editing; while
+        //  op1_is_result is set, compute() takes operand 1 from here.
+    UINT64 result;
+    UINT8 result_dig[RESULT_DIGITS];
+    UINT8 result_len;
+    BOOLEAN__ op1_is_result;
+        // The last compute overloaded; cleared by the next entry
+    BOOLEAN__ error;
+        // Window of a wide result being shown, and when to move on
+    UINT8 page;
+    UINT32 page_due;
+};
+
+    // Statistics accumulators; see SIGMA_ADD.
+struct sigma_acc{
+    UINT32 count;
+    INT64 sum;
+        // Sum of squares, sq_hi:sq_lo
+    UINT64 sq_lo;
+    UINT32 sq_hi;
+    INT32 low, high;
+};
+
+    // What survives a power cycle. The wide result is kept as a value;
+    //  its digits are worked out again on the way back.
+struct saved_state{
+    UINT64 result;
+    expression_data exp;
+    UINT8 version;
+    UINT8 magnitude, num_to_display;
+    STATE_TYPE state;
+    UINT8 radix_sel, dim_level;
+    BOOLEAN__ op1_is_result, error;
 };
 
     /**********   End type aliasing     **********/
@@ -82,9 +294,123 @@ struct calculator_information_packet{
 #ifdef RUN_SOFT_CHECK
     void test_software(void);
 #endif
+#ifdef RUN_BENCH
+        // Time compute_wide() against the same operators in plain C, which
+        //  the compiler hands to libgcc.
+    void bench_arith(void);
+    INT64 plain_op(UINT8 op_code, INT64 op1, INT64 op2);
+    void bench_show(UINT32 cycles, UINT8 op_n, BOOLEAN__ baseline);
+#endif
+#ifdef HOST_SIM
+        // Host tools: evaluate one expression on its own, as Enter would,
+        //  in radix entry radix_sel; returns as compute(). result_digits
+        //  then points at the digits, least significant first, and
+        //  returns how many there are.
+    BOOLEAN__ compute_exp(
+        const UINT8* operand, UINT8 is_neg, UINT8 op_code, UINT8 radix_sel
+        );
+    UINT8 result_digits(const UINT8** digits, BOOLEAN__* neg);
+#endif
 
-    // Main program
+    // Main program. Runs the calculator as a set of tasks until the
+    //  termination chord has been pressed, or it has been left alone for
+    //  IDLE_OFF_MS, and the shutdown animation is over.
 void run_calculator(void);
+    // Register the tasks with the scheduler. Done once at start up.
+void configure_tasks(void);
+    // Start scanning the keypad and refreshing the display.
+void start_io_tasks(void);
+
+    // Tasks
+    //  scan_task reads the keypad row that was lit during the last
+    //  millisecond and queues debounced key presses.
+    //  display_task lights the next digit until the next millisecond.
+    //  calc_task runs the calculator on every queued key.
+    //  anim_task steps the animation in progress by one frame.
+    // scan_task and display_task run every millisecond, and with RAM_HOT
+    //  they and what they call run from RAM; see hal.h.
+HAL_RAMFUNC void scan_task(void);
+HAL_RAMFUNC void display_task(void);
+void calc_task(void);
+void anim_task(void);
+    //  perf_task samples the loop rate.
+void perf_task(void);
+    //  save_task writes the calculator to flash if it changed.
+void save_task(void);
+    //  idle_task enters the next stage of inactivity when it is due.
+void idle_task(void);
+    // Start the inactivity timer over. A dimmed or dark display comes
+    //  back; returns TRUE__ when it had to.
+BOOLEAN__ idle_wake(void);
+    // Time the next stage of inactivity after stage, if there is one.
+void idle_arm(UINT8 stage);
+    // Set the inactivity times, in ms from the last key, 0 to leave the
+    //  stage out. Taken up from the next key on.
+void idle_timeouts(UINT32 dim_ms, UINT32 blank_ms, UINT32 off_ms);
+    // Stop the calculator, saving it, and start the shutdown animation.
+void shut_down(void);
+    // Bring back the calculator as it was last saved, if it was.
+void restore_state(void);
+    //  serial_task runs commands that came in over the serial port and
+    //  sends telemetry. While the calculator is off it is called from the
+    //  power-on loop instead.
+    //
+    // Commands are one per line. Each is answered by one line starting
+    //  with the same letter, or by "?" when it is not understood:
+    //      k <keys>    press keys by name, as in the simulator traces
+    //      d           the display, as the batch tool writes it: d [ 46.  ]
+    //      p           the calculator_information_packet, as name=value
+    //      c           the counters of the stats view, in decimal
+    //      t <ms>      send telemetry every ms, 0 to stop
+    //      r           the next trace records not read yet
+    //  Telemetry lines read "T <ms since start> <display> <counters>".
+    //  Trace replies read "r <seq> <record>...", up to TRACE_PER_REPLY
+    //  records from number seq on, each as 16 hex digits: at, kind, arg,
+    //  value (see trace.h). A bare "r" means none are left, and always
+    //  without EVENT_TRACE.
+    //  Commands sent ahead of their replies have to fit in the receive
+    //  ring. Keys go through the same queue as the keypad, and a command
+    //  after k sees their effect. While off, only the power-on key P does
+    //  anything.
+void serial_task(void);
+    // Run the command in cmd_line. Returns FALSE__ when it has to wait for
+    //  room in the key queue or for its reply, and wants to run again.
+BOOLEAN__ run_command(void);
+    // Keypad row and column bits of a key by its simulator name. Returns
+    //  FALSE__ for an unknown name.
+BOOLEAN__ key_by_name(char name, UINT8* row, UINT8* col);
+    // Reply text. Each writes at at and returns the end of what it wrote.
+char* text_dec(char* at, UINT32 value);
+char* text_hex(char* at, UINT32 value, UINT8 digits);
+char* text_label(char* at, const char* label);
+char* text_field(char* at, const char* label, UINT32 value);
+char* text_display(char* at);
+char* text_packet(char* at);
+char* text_counters(char* at);
+    // Run the calculator on one key press: the row and the column bits
+    //  that went down together. Returns FALSE__ on the termination chord,
+    //  which is left to the caller.
+BOOLEAN__ press_key(UINT8 row, UINT8 col);
+    // Repeat the input of the last press, if that was the key at row and
+    //  col and it entered a digit or deleted.
+void repeat_key(UINT8 row, UINT8 col);
+    // Act on one decoded input.
+void apply_input(INPUT_TYPE in_type, UINT8 button);
+    // What digit select shows right now: its digit code (NULL_DIG or
+    //  BLANK_DIG when dark) and whether its dot is lit. Timed paging is
+    //  left to the caller.
+HAL_RAMFUNC UINT8 shown_dig(UINT8 select, BOOLEAN__* dot_dest);
+    // Whether the sign indicator is lit
+HAL_RAMFUNC BOOLEAN__ shown_sign(void);
+    // Begin an animation ending in the given number of blinks, each on
+    //  and then off for blink_ms.
+void anim_start(UINT8 kind, UINT8 blinks, UINT32 blink_ms);
+
+    // Key press queue between scan_task and calc_task. A press is the row
+    //  and the column bits that went down together, with KEY_REPEAT added
+    //  for an auto-repeat.
+HAL_RAMFUNC void push_key(UINT8 row, UINT8 col);
+BOOLEAN__ pop_key(UINT8* row, UINT8* col);
 
 void delete_last_entry(void);
 
@@ -100,8 +426,79 @@ void configure_ports(void);
     //  use comptue to store the resulting value as the first operand
     //  in the information packet. This might also allow extension into
     //  chained expressions.
-    // Return whether or not an overload has occurred.
+    // Return whether or not an overload has occurred, in which case the
+    //  information packet is left as it was.
 BOOLEAN__ compute(void);
+    // Apply op_code to two signed values at 64 bits. Sets *over when the
+    //  magnitude of the result exceeds WIDE_MAX or on division by zero.
+INT64 compute_wide(UINT8 op_code, INT64 op1, INT64 op2, BOOLEAN__* over);
+    // Multiply and divide kernels for compute_wide(). The M0+ only has a
+    //  32 bit multiply returning the low word and no divide at all, so the
+    //  plain C operators on 64 bit values go to generic libgcc helpers.
+    //  mul32x32 builds the full product from 16 bit partial products.
+    //  mul_wide returns a*b, setting *over if it needs more than 64 bits.
+    //  div64x32 divides hi:lo by d, one quotient bit per step, and needs
+    //  hi < d; it returns the quotient and leaves the remainder in *rem.
+    //  div_wide divides *n by d in place and returns the remainder.
+UINT64 mul32x32(UINT32 a, UINT32 b);
+UINT64 mul_wide(UINT64 a, UINT32 b, BOOLEAN__* over);
+UINT32 div64x32(UINT32 hi, UINT32 lo, UINT32 d, UINT32* rem);
+UINT32 div_wide(UINT64* n, UINT32 d);
+    // Arithmetic on numbers of several 32 bit limbs, least significant
+    //  first, for the statistics.
+    //  mac_limbs adds a times b to the len limbs of acc; what does not fit
+    //  is dropped.
+    //  sub_limbs takes b from acc, both len limbs.
+    //  div_limbs divides count limbs by d in place, returning the
+    //  remainder.
+void mac_limbs(
+    UINT32* acc, UINT8 len, const UINT32* a, UINT8 a_len, UINT32 b
+);
+void sub_limbs(UINT32* acc, const UINT32* b, UINT8 len);
+UINT32 div_limbs(UINT32* limbs, UINT8 count, UINT32 d);
+    // Keep value as the full width result and put its low digits in
+    //  operand 1's slot. Returns the number of digits put there.
+UINT8 store_result(UINT64 value);
+    // Show value as a result, the way compute() leaves one.
+void show_value(INT64 value);
+    // The value on show, whether an operand being keyed or a result.
+    //  Fails when the operand on show has no digits yet.
+BOOLEAN__ shown_value(INT64* dest);
+
+    // Statistics; see SIGMA_ADD.
+    //  sigma_add fails, leaving the accumulators as they were, for a value
+    //  beyond SIGMA_LIMIT or once SIGMA_COUNT_MAX values are in.
+    //  sigma_get fails for anything but the count with no values in, and
+    //  for the variance with fewer than two.
+    //  sigma_variance needs two values or more.
+void sigma_clear(void);
+BOOLEAN__ sigma_add(INT64 value);
+BOOLEAN__ sigma_get(UINT8 stat, INT64* dest);
+UINT64 sigma_variance(void);
+    // Run statistics key key of FN, showing what it gives or the error.
+void apply_sigma(UINT8 key);
+    // Step a wide result to its next window and schedule the step after.
+void next_page(void);
+
+    // Conversions between stored digits and binary, in the current radix.
+    //  Neither divides; decimal goes through divu10().
+    //  join_digits reads up to count digits, stopping at NULL_DIG.
+    //  split_digits writes the count least significant digits of value,
+    //  most significant first.
+    //  store_value writes value left aligned without leading zeros,
+    //  padding with NULL_DIG, and returns the number of digits used.
+UINT32 join_digits(const UINT8* digits, UINT8 count);
+void split_digits(UINT32 value, UINT8* digits, UINT8 count);
+UINT8 store_value(UINT32 value, UINT8* digits);
+    // Exact unsigned division by ten with shifts and adds only.
+UINT32 divu10(UINT32 n);
+    // Divide by the current radix, picking between divu10() and a shift
+    //  with a mask rather than a branch.
+UINT32 div_radix(UINT32 value);
+    // Switch to radix entry sel of the cycle, converting the operands in
+    //  place. Fails if an entered operand would not fit in MAX_DIGITS
+    //  digits; a result always fits.
+BOOLEAN__ set_radix(UINT8 sel);
 
     // Store digit attempts to push digit to lsd of current number
     //  being used based on available space and the current state
@@ -120,15 +517,23 @@ BOOLEAN__ store_op(UINT8 new_op);
     //        - Multiplication    --> MUL_GLYPH
     //        - Division          --> DIV_GLYPH
     //    For Enter and Delete inputs, the code is 0.
+    //    For the brightness chord (keys 12 and 14), the code is 0.
+    //    For the FN chord (keys 0 and 3), the code is 0.
+    //    For the stats chord (keys 12 and 15), the code is 0.
 INPUT_TYPE decode_input_type(UINT8* i_code, UINT8 row, UINT8 col);
+    // Give an input decoded after the FN prefix its second meaning.
+INPUT_TYPE second_function(INPUT_TYPE in_type, UINT8* i_code);
 
         /**********   Start IO functions   **********/
-    // Display single to one of the seven segment displays
-void display_dig(
+    // Display single to one of the seven segment displays, and hold it
+    //  lit for add_delay us on the timer.
+HAL_RAMFUNC void display_dig(
     UINT32 add_delay, UINT8 dig_to_display, UINT8 select,
     BOOLEAN__ show_dot, BOOLEAN__ show_sign
 );
 
+    // Blocking key scan for the hardware test; the calculator scans from
+    //  scan_task().
     // Check for any input (key press) and provide debouncing functionality.
     //  0 - 15 denotes key on keypad from right to left then bottom to top
     //  TERMINATION_KEY2 denotes combo key to terminate program
@@ -136,18 +541,24 @@ void display_dig(
     //    8 denotes the delete key
     //    12 denotes the enter key
 void check_key(UINT8* row_dest, UINT8* col_dest);
+
+    // Select one of DIM_LEVELS brightness levels, 0 being the dimmest.
+    //  Only the compare values change, so the cost is a few stores.
+void set_brightness(UINT8 level);
         /**********    End IO functions    **********/
 
     // Initial state is defined as all seven segment displays turned off.
     //  However, power is still present. All data in the global information
     //  packet is reset to predefined values.
 void set_initial_state(void);
+    // The calculator part of set_initial_state, leaving the pins alone.
+void reset_calculator(void);
+    // reset_calculator, and the statistics and counters cleared as well:
+    //  the calculator as it comes out of a power up.
+void reset_unit(void);
     // Ensure the structure values are set to default values.
 void reset_info_pack(void);
-    // Shutdown state is defined similarly to set_initial_state with the
-    //  exception that power is switched off.
-void shutdown(void);
-    // An indicator
+    // An indicator. Runs the blink animation to the end.
 void blink_rdy(UINT32 add_delay);
     // Debounce key presses for validation.
 UINT8 debounce_keypress(void);
@@ -156,27 +567,86 @@ UINT8 debounce_keypress(void);
     /**********   Start global variables   **********/
         // Since the majority of functions in this file depend
         //  on modifying common variables, go ahead and make them
-        //  global.
-static struct calculator_information_packet cip;
-
-        // These variables are shared by multiple IO functions.
-static Port* port;
-static PortGroup *bankA, *bankB;
+        //  global. Everything a unit changes is HAL_UNIT, so that the
+        //  host can run one calculator per thread; see hal.h.
+static HAL_UNIT struct calculator_information_packet cip;
+        // Statistics, and the one SIGMA_NEXT showed last
+static HAL_UNIT struct sigma_acc sigma;
+static HAL_UNIT UINT8 sigma_sel;
+
+        // Compare values for each brightness level. The steps are roughly
+        //  geometric since perceived brightness is not linear in duty.
+static const UINT8 dim_duty[DIM_LEVELS] = {0x04, 0x0C, 0x20, DIM_PERIOD};
+static HAL_UNIT UINT8 dim_level;
+
+        // Task ids
+static HAL_UNIT UINT8 scan_id, display_id, calc_id, anim_id;
+
+        // Key presses on their way to calc_task
+static HAL_UNIT UINT8 key_queue[KEY_QUEUE_LEN];
+static HAL_UNIT UINT8 key_head, key_tail;
+        // Per row debouncing: the columns accepted, the columns last read
+        //  and for how many scans they have read the same. Rows and digits
+        //  share their pins, so there are as many rows as digits.
+static HAL_UNIT UINT8 key_stable[MAX_DIGITS], key_seen[MAX_DIGITS];
+static HAL_UNIT UINT8 key_count[MAX_DIGITS];
+        // Auto-repeat per row: when the next repeat is due and the gap
+        //  after it, 0 when the row is not repeating
+static HAL_UNIT UINT32 key_due[MAX_DIGITS];
+static HAL_UNIT UINT8 key_gap[MAX_DIGITS];
+        // The last press and the input it made, for repeats
+static HAL_UNIT UINT8 last_key;
+static HAL_UNIT INPUT_TYPE last_type;
+static HAL_UNIT UINT8 last_button;
+        // Digit lit by display_task, which is also the row to scan next
+static HAL_UNIT UINT8 disp_row;
+static HAL_UNIT BOOLEAN__ fn_pending;
+
+static HAL_UNIT UINT8 anim_kind, anim_step, anim_blinks;
+static HAL_UNIT UINT32 anim_blink_ms;
+
+static HAL_UNIT UINT32 perf[PERF_COUNT];
+        // Counter being shown, from 1; 0 when the stats are not up
+static HAL_UNIT UINT8 stat_sel, stat_page;
+static HAL_UNIT UINT32 stat_due, perf_passes;
+static HAL_UNIT UINT8 perf_id;
+        // Last state saved or restored. Kept static, so that the padding
+        //  compared by persist_save() is always zero.
+static HAL_UNIT struct saved_state saved;
+static HAL_UNIT UINT8 save_id;
+        // Inactivity times by stage, from IDLE_DIM, the stage the display
+        //  is in and the one the idle task enters next
+static HAL_UNIT UINT32 idle_ms[IDLE_OFF] = {
+    IDLE_DIM_MS, IDLE_BLANK_MS, IDLE_OFF_MS
+};
+static HAL_UNIT UINT8 idle_stage, idle_next;
+static HAL_UNIT UINT8 idle_id;
+
+        // Serial command being taken in or run, and for k the next key
+static HAL_UNIT char cmd_line[CMD_LEN];
+static HAL_UNIT UINT8 cmd_len, cmd_pos;
+static HAL_UNIT BOOLEAN__ cmd_ready, cmd_long;
+static HAL_UNIT char reply[REPLY_LEN];
+        // Telemetry period, 0 when off, and when the next line is due
+static HAL_UNIT UINT32 tele_ms, tele_due;
+static HAL_UNIT UINT8 serial_id;
+static HAL_UNIT BOOLEAN__ calc_on, remote_start;
+
+static const UINT8 radix_cycle[RADIX_COUNT] = {10u, 16u, 8u, 2u};
+static const UINT8 radix_shifts[RADIX_COUNT] = {0u, 4u, 3u, 1u};
     /**********    End global variables    **********/
 
     /**********   Start function definitions   **********/
-int main(void){
+int FIRMWARE_MAIN(void){
 
     configure_ports();
+    configure_tasks();
 
     volatile BOOLEAN__ start = TRUE__;
-        // Force an infinite loop. In a future implementation using
-        //  interrupts, have the device go to sleep while waiting
-        //  for prompt.
-    while(TRUE__){
+        // Force an infinite loop, sleeping between checks for the
+        //  power-on chord.
+    while(HAL_RUNNING()){
         if(start){
-            blink_rdy(250);
-
             set_initial_state();
 
         #ifdef RUN_SOFT_CHECK
@@ -187,12 +657,17 @@ int main(void){
             test_hardware();
         #endif
 
-            run_calculator();
+        #ifdef RUN_BENCH
+            bench_arith();
+        #endif
 
-            shutdown();
+            run_calculator();
         }
-        bankA->OUT.reg &= ~0x10;
-        start = ((bankA->IN.reg >> 16u) & 0xF) == 0xF;
+        serial_task();
+        hal_dig_on(0);
+        start = hal_key_cols() == KEY_COL_ALL || remote_start;
+        remote_start = FALSE__;
+        sched_sleep(POWER_POLL_MS);
     }
 
     return 0;
@@ -202,23 +677,23 @@ int main(void){
 void test_hardware(void){
     // Run visual check on seven segment displays
     // Turn on all LEDs
-    bankA->OUT.reg &= ~0xF0;
-    bankB->OUT.reg &= ~0xFF;
-    delay_ms(1000);
+    hal_dig_all_on();
+    hal_seg_on(SEG_BUS_MASK);
+    sched_sleep(1000);
 
     // Turn off one segment at a time
     UINT32 lit_bit = 1;
 #define TEST_DELY__ 50
     for (; lit_bit < (1u << 8); lit_bit <<= 1){
-        bankB->OUT.reg |= lit_bit;
-        delay_ms(TEST_DELY__);
+        hal_seg_off(lit_bit);
+        sched_sleep(TEST_DELY__);
     }
 
     // Turn on one number at a time
     lit_bit = 0u;
     for (; lit_bit < 16u; ++lit_bit){
         display_dig(5000, lit_bit, 1, FALSE__, FALSE__);
-        delay_ms(TEST_DELY__ * 3);
+        sched_sleep(TEST_DELY__ * 3);
     }
     // Run semi-infinite loop to test keypad input
     UINT8 row = 0x0, col_byte = 0x0, button = 0xFF;
@@ -289,54 +764,706 @@ void test_software(void){
 }
 #endif
 
-void run_calculator(){
+#ifdef RUN_BENCH
+#define BENCH_ROUNDS    16u
+#define BENCH_SHOW_MS   2000u
+void bench_arith(void){
+        // Shown in this order, on the idle clock and then again with the
+        //  ready indicator lit on the burst clock. The dot marks the
+        //  operator, counting from the left, and the sign LED marks the
+        //  libgcc baseline. Cycles over the clock in MHz give the latency
+        //  in microseconds.
+    static const UINT8 ops[4] = {ADD_GLYPH, SUB_GLYPH, MUL_GLYPH, DIV_GLYPH};
+    static HAL_UNIT INT64 op1[BENCH_ROUNDS], op2[BENCH_ROUNDS];
+    volatile INT64 sink = 0x0;
+    UINT32 seed = 0x2545F491u, start = 0x0, wide = 0x0, plain = 0x0;
+    UINT8 counter = 0x0, op_n = 0x0, burst = 0x0;
+    BOOLEAN__ over = FALSE__;
+
+        // A wide first operand, as left by a chained result, and an
+        //  entered second operand of up to four digits
+    for(; counter < BENCH_ROUNDS; ++counter){
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        op1[counter] = ((INT64)seed << 8) * ((seed & 0x1) ? -1 : 1);
+        op2[counter] = (INT64)(seed % 9999u + 1u) * ((seed & 0x2) ? -1 : 1);
+    }
+
+    hal_cycles_init();
+    for(; burst < 2u; ++burst){
+        clock_policy(burst ? CLOCK_POLICY_BURST : CLOCK_POLICY_IDLE);
+        hal_rdy_set(burst);
+        for(op_n = 0x0; op_n < 4u; ++op_n){
+            start = hal_cycles();
+            for(counter = 0x0; counter < BENCH_ROUNDS; ++counter){
+                sink = compute_wide(
+                    ops[op_n], op1[counter], op2[counter], &over
+                    );
+            }
+            wide = (hal_cycles() - start) & HAL_CYCLES_MASK;
+
+            start = hal_cycles();
+            for(counter = 0x0; counter < BENCH_ROUNDS; ++counter)
+                sink = plain_op(ops[op_n], op1[counter], op2[counter]);
+            plain = (hal_cycles() - start) & HAL_CYCLES_MASK;
+
+            bench_show(wide / BENCH_ROUNDS, op_n, FALSE__);
+            bench_show(plain / BENCH_ROUNDS, op_n, TRUE__);
+        }
+    }
+    clock_policy(CLOCK_POLICY_SWITCH);
+    hal_rdy_set(FALSE__);
+    (void)sink;
+
     set_initial_state();
+    blink_rdy(250);
+}
+INT64 plain_op(UINT8 op_code, INT64 op1, INT64 op2){
+    switch(op_code){
+        case ADD_GLYPH: return op1 + op2;
+        case SUB_GLYPH: return op1 - op2;
+        case MUL_GLYPH: return op1 * op2;
+        case DIV_GLYPH: return op2 ? op1 / op2 : 0;
+        default:        return op1;
+    }
+}
+void bench_show(UINT32 cycles, UINT8 op_n, BOOLEAN__ baseline){
+    UINT8 digits[MAX_DIGITS], row = 0x0;
+    UINT32 until = sched_now() + BENCH_SHOW_MS;
+    split_digits(cycles > 9999u ? 9999u : cycles, digits, MAX_DIGITS);
+    while(!sched_expired(until)){
+        for(row = 0x0; row < MAX_DIGITS; ++row){
+            display_dig(
+                1000, digits[MAX_DIGITS-1u-row], row,
+                row == MAX_DIGITS-1u-op_n, baseline
+                );
+        }
+    }
+}
+#endif
+
+#ifdef HOST_SIM
+BOOLEAN__ compute_exp(
+    const UINT8* operand, UINT8 is_neg, UINT8 op_code, UINT8 radix_sel
+){
+    UINT8 counter = MAX_DIGITS*0x2;
+    reset_info_pack();
+    cip.radix_sel = radix_sel;
+    cip.radix = radix_cycle[radix_sel];
+    cip.radix_shift = radix_shifts[radix_sel];
+    for(; counter > 0x0; --counter)
+        cip.exp.operand[counter-0x1] = operand[counter-0x1];
+    cip.exp.index = MAX_DIGITS*0x2;
+    cip.exp.op_code = op_code;
+    cip.exp.is_neg = is_neg;
+    return compute();
+}
 
+UINT8 result_digits(const UINT8** digits, BOOLEAN__* neg){
+    *digits = cip.result_dig;
+    *neg = cip.exp.is_neg & 0x1;
+    return cip.result_len;
+}
+#endif
+
+void run_calculator(){
+        // Keys are taken from the start; the ready blink runs on its own
+    set_initial_state();
+    restore_state();
+    start_io_tasks();
+    sched_start(calc_id, 0u);
+    anim_start(ANIM_BOOT, BOOT_BLINKS, BOOT_BLINK_MS);
+    calc_on = TRUE__;
+    sched_start(serial_id, 0u);
+    sched_run();
+    sched_stop(serial_id);
+    calc_on = FALSE__;
+}
+void configure_tasks(void){
+    sched_reset();
+        // In priority order. The scan has to see the row before the
+        //  display moves on to the next one.
+    scan_id = sched_add("scan", scan_task, SCAN_PERIOD_MS, SCAN_PERIOD_MS);
+    display_id = sched_add(
+        "display", display_task, DISPLAY_PERIOD_MS, DISPLAY_PERIOD_MS
+        );
+    calc_id = sched_add("calc", calc_task, 0u, CALC_DEADLINE_MS);
+    anim_id = sched_add("anim", anim_task, 0u, ANIM_DEADLINE_MS);
+    perf_id = sched_add("perf", perf_task, PERF_PERIOD_MS, PERF_PERIOD_MS);
+    save_id = sched_add("save", save_task, 0u, SAVE_DEADLINE_MS);
+    idle_id = sched_add("idle", idle_task, 0u, IDLE_DEADLINE_MS);
+    serial_id = sched_add(
+        "serial", serial_task, SERIAL_PERIOD_MS, SERIAL_PERIOD_MS
+        );
+}
+void start_io_tasks(void){
+    UINT8 counter = MAX_DIGITS;
+        // Count every key as already down, so that keys still held from
+        //  the power-on chord only act once let go and pressed again
+    for(; counter > 0x0; --counter){
+        key_stable[counter-0x1] = key_seen[counter-0x1] = KEY_COL_ALL;
+        key_count[counter-0x1] = DEBOUNCE_SCANS;
+        key_gap[counter-0x1] = 0x0;
+    }
+    key_head = key_tail = 0x0;
+    idle_stage = IDLE_AWAKE;
+    sched_start(scan_id, 0u);
+    sched_start(display_id, 0u);
+    perf_passes = sched_passes();
+    sched_start(perf_id, PERF_PERIOD_MS);
+}
+void scan_task(void){
+    UINT8 row = disp_row, cols = 0x0, button = 0x0;
+    INPUT_TYPE type = NO_INPUT;
+        // Blank first so the row does not flash at full brightness
+    hal_seg_blank();
+    hal_row_drive(row);
+    cols = hal_key_cols();
+    if(cols != key_seen[row]){
+        if(key_count[row] < DEBOUNCE_SCANS) ++perf[PERF_REJECTS];
+        key_seen[row] = cols;
+        key_count[row] = 0x1;
+        return;
+    }
+    if(key_count[row] >= DEBOUNCE_SCANS){
+        if(!key_gap[row] || !sched_expired(key_due[row]))   return;
+        push_key(row, cols | KEY_REPEAT);
+        ++perf[PERF_REPEATS];
+        key_due[row] += key_gap[row];
+        key_gap[row] = key_gap[row] > REPEAT_MIN_MS + REPEAT_STEP_MS
+            ? key_gap[row] - REPEAT_STEP_MS : REPEAT_MIN_MS;
+        return;
+    }
+    if(++key_count[row] < DEBOUNCE_SCANS)   return;
+        // Settled. Only keys going down make a press, so letting go of
+        //  part of a chord does not. Any change ends a repeat.
+    key_gap[row] = 0x0;
+    if((cols & ~key_stable[row]) && !idle_wake()){
+        push_key(row, cols);
+        type = decode_input_type(&button, row, cols);
+        if(
+            REPEAT_DELAY_MS && !(cols & (cols - 1u))
+            && (type == DIG_INPUT || type == DEL_INPUT)
+        ){
+            key_gap[row] = REPEAT_START_MS;
+            key_due[row] = sched_now() + REPEAT_DELAY_MS;
+        }
+    }
+    key_stable[row] = cols;
+}
+void display_task(void){
+    UINT8 row = disp_row = (disp_row + 1u) % MAX_DIGITS;
+    UINT8 shown = NULL_DIG;
+    BOOLEAN__ dot = FALSE__;
+    if(idle_stage == IDLE_BLANK)    return;
+        // Page through a wide result on the refresh timer
+    if(
+        cip.state == ENT_FIN_STATE && cip.result_len > MAX_DIGITS
+        && sched_expired(cip.page_due)
+    )   next_page();
+    if(stat_sel && sched_expired(stat_due)){
+        stat_page ^= 0x1;
+        stat_due = sched_now() + PAGE_MS;
+    }
+    shown = shown_dig(row, &dot);
+    display_dig(0, shown, row, dot, shown_sign());
+}
+UINT8 shown_dig(UINT8 select, BOOLEAN__* dot_dest){
+    UINT8 pos = 0x0;
+    *dot_dest = FALSE__;
+    if(stat_sel){
+        *dot_dest = (stat_sel >> select) & 0x1;
+        return (perf[stat_sel-1u] >> ((stat_page*MAX_DIGITS + select)*4u))
+            & 0xF;
+    }
+    if(cip.error)
+        return select == MAX_DIGITS-1u ? ERROR_DIG : NULL_DIG;
+    if(cip.state == ENT_FIN_STATE && cip.result_len > MAX_DIGITS){
+        pos = cip.page*MAX_DIGITS + select;
+        *dot_dest = ((cip.page + 1u) >> select) & 0x1;
+        return pos < cip.result_len ? cip.result_dig[pos] : BLANK_DIG;
+    }
+    pos = cip.exp.operand[cip.num_to_display*4u+MAX_DIGITS-1u-select];
+        // display_dig() drops the dot of an empty digit
+    *dot_dest = pos != NULL_DIG && select ==
+        MAX_DIGITS-1-((cip.exp.index-1u)%MAX_DIGITS)+MAX_PRECISION;
+    return pos;
+}
+BOOLEAN__ shown_sign(void){
+    if(stat_sel)    return stat_page;
+    return (cip.exp.is_neg >> cip.num_to_display) & 0x1;
+}
+void calc_task(void){
+    UINT8 row = 0x0, col_byte = 0x0;
+    clock_burst_begin();
+        // Every run starts the save delay and the inactivity timer over
+    sched_start(save_id, SAVE_DELAY_MS);
+    idle_wake();
+    while(pop_key(&row, &col_byte)){
+        if(col_byte & KEY_REPEAT){
+            repeat_key(row, col_byte & KEY_COL_ALL);
+            continue;
+        }
+        if(!press_key(row, col_byte)){
+            shut_down();
+            break;
+        }
+    }
+    clock_burst_end();
+}
+void shut_down(void){
+    sched_stop(scan_id);
+    sched_stop(display_id);
+    sched_stop(calc_id);
+    sched_stop(perf_id);
+    sched_stop(save_id);
+    sched_stop(idle_id);
+    save_task();
+        // Keys still queued die with the keypad
+    key_tail = key_head;
+    anim_start(ANIM_SHUT, SHUT_BLINKS, SHUT_BLINK_MS);
+}
+BOOLEAN__ press_key(UINT8 row, UINT8 col){
     UINT8 button = 0x0;
-    UINT8 row = 0xF0, col_byte = 0xF0;
-    INPUT_TYPE in_type = NO_INPUT;
-        // Start processing key presses
-    while(
-        check_key(&row, &col_byte),
-        ((in_type = decode_input_type(&button, row, col_byte)) != TERM_INPUT
-            && button != TERMINATION_KEY)
-    ){
-        switch(in_type){
-            case DEL_INPUT:
-                delete_last_entry();
-                continue;
-            case DIG_INPUT:
-                if (!store_dig(button)){
-                    /*Consider doing something*/
+    INPUT_TYPE in_type = decode_input_type(&button, row, col);
+    TRACE(TRACE_INPUT, in_type, button);
+        // Both termination chords decode as TERM_INPUT. Do not test
+        //  the code alone: hex digit F shares its value.
+    if(in_type == TERM_INPUT)   return FALSE__;
+    if(fn_pending && in_type != NO_INPUT){
+        fn_pending = FALSE__;
+        in_type = second_function(in_type, &button);
+    }
+    last_key = (row << 4) | col;
+    last_type = in_type;
+    last_button = button;
+    apply_input(in_type, button);
+    return TRUE__;
+}
+void repeat_key(UINT8 row, UINT8 col){
+    if(last_key != ((row << 4) | col))  return;
+    if(last_type == DIG_INPUT || last_type == DEL_INPUT)
+        apply_input(last_type, last_button);
+}
+void apply_input(INPUT_TYPE in_type, UINT8 button){
+    ++perf[PERF_KEYS + in_type];
+    hal_work(KEY_WORK_CYCLES);
+    if(in_type != STATS_INPUT && in_type != NO_INPUT)   stat_sel = 0x0;
+    switch(in_type){
+        case DEL_INPUT:
+            delete_last_entry();
+            TRACE(TRACE_DEL, cip.state, cip.exp.index);
+            break;
+        case DIG_INPUT:
+            if (!store_dig(button)){
+                /*Consider doing something*/
+            }
+            TRACE(TRACE_DIG, cip.state, cip.exp.index << 8 | button);
+            break;
+        case OP_INPUT:
+            if (!store_op(button)){
+                /*Consider doing something*/
+            }
+            TRACE(TRACE_OP, cip.state, cip.exp.index << 8 | button);
+            break;
+        case ENT_INPUT:
+            if(cip.state == ENT_FIN_STATE){
+                if(cip.result_len > MAX_DIGITS) next_page();
+            } else if(cip.exp.index >= MAX_DIGITS){
+                cip.page = 0x0;
+                ++perf[PERF_COMPUTES];
+                hal_work(COMPUTE_WORK_CYCLES);
+                if(compute()){
+                    ++perf[PERF_OVERFLOWS];
+                    reset_info_pack();
+                    cip.error = TRUE__;
+                } else if(cip.result_len > MAX_DIGITS){
+                    next_page();
                 }
-                break;
-            case OP_INPUT:
-                if (!store_op(button)){
-                    /*Consider doing something*/
+                TRACE(TRACE_COMPUTE, cip.error, cip.result);
+                cip.state = ENT_FIN_STATE;
+                cip.num_to_display = 0u;
+            }
+            break;
+        case BRIGHT_INPUT:
+            set_brightness(dim_level + 1u);
+            break;
+        case FN_INPUT:
+            fn_pending = TRUE__;
+            break;
+        case STATS_INPUT:
+            stat_sel = stat_sel < PERF_COUNT ? stat_sel + 1u : 0x0;
+            stat_page = 0x0;
+            stat_due = sched_now() + PAGE_MS;
+            break;
+        case RADIX_INPUT:
+            if (!set_radix(cip.radix_sel + 1u)){
+                /*Consider doing something*/
+            }
+            break;
+        case SIGMA_INPUT:
+            apply_sigma(button);
+            TRACE(TRACE_SIGMA, button, sigma.count);
+            break;
+        case NO_INPUT:  break;
+        default:        break;
+    }
+}
+void anim_start(UINT8 kind, UINT8 blinks, UINT32 blink_ms){
+    anim_kind = kind;
+    anim_step = 0x0;
+    anim_blinks = blinks;
+    anim_blink_ms = blink_ms;
+    sched_start(anim_id, 0u);
+}
+void anim_task(void){
+        // Shutdown banner by row, read right to left
+    static const UINT8 banner[MAX_DIGITS] = {7u, 3u, 3u, 1u};
+    UINT8 step = anim_step++;
+    if(anim_kind == ANIM_SHUT){
+        if(step < SHUT_PASSES*MAX_DIGITS){
+            display_dig(
+                0, banner[step % MAX_DIGITS], step % MAX_DIGITS,
+                FALSE__, FALSE__
+                );
+            sched_start(anim_id, SHUT_FRAME_MS);
+            return;
+        }
+        if(step == SHUT_PASSES*MAX_DIGITS)  set_initial_state();
+        step -= SHUT_PASSES*MAX_DIGITS;
+    }
+    if(step < anim_blinks*2u){
+            // The boot blink shares the board with the running display,
+            //  so only the ready indicator is its own
+        if(anim_kind != ANIM_BOOT){
+            hal_seg_blank();
+            hal_sign_set(!(step & 0x1));
+        }
+        hal_rdy_set(!(step & 0x1));
+        sched_start(anim_id, anim_blink_ms);
+        return;
+    }
+    if(anim_kind != ANIM_BOOT)  sched_exit();
+}
+void perf_task(void){
+    UINT32 passes = sched_passes();
+    perf[PERF_LOOP_RATE] = passes - perf_passes;
+    perf_passes = passes;
+}
+void save_task(void){
+    saved.result = cip.result;
+    saved.exp = cip.exp;
+    saved.version = SAVE_VERSION;
+    saved.magnitude = cip.magnitude;
+    saved.num_to_display = cip.num_to_display;
+    saved.state = cip.state;
+    saved.radix_sel = cip.radix_sel;
+    saved.dim_level = dim_level;
+    saved.op1_is_result = cip.op1_is_result;
+    saved.error = cip.error;
+    persist_save(&saved, sizeof(saved));
+}
+void idle_task(void){
+    idle_stage = idle_next;
+    switch(idle_stage){
+        case IDLE_DIM:
+            hal_dim_set(IDLE_DIM_DUTY);
+            break;
+        case IDLE_BLANK:
+                // display_task goes on stepping the rows for the scan,
+                //  with nothing lit
+            hal_seg_blank();
+            hal_sign_set(FALSE__);
+            break;
+        default:
+            shut_down();
+            return;
+    }
+    idle_arm(idle_stage);
+}
+BOOLEAN__ idle_wake(void){
+    BOOLEAN__ woke = idle_stage != IDLE_AWAKE;
+    if(woke)    set_brightness(dim_level);
+    idle_stage = IDLE_AWAKE;
+    idle_arm(IDLE_AWAKE);
+    return woke;
+}
+void idle_arm(UINT8 stage){
+    UINT32 since = stage == IDLE_AWAKE ? 0u : idle_ms[stage - 1u];
+    UINT8 next = stage + 1u;
+    for(; next <= IDLE_OFF; ++next){
+        UINT32 at = idle_ms[next - 1u];
+        if(!at) continue;
+        idle_next = next;
+        sched_start(idle_id, at > since ? at - since : 0u);
+        return;
+    }
+    sched_stop(idle_id);
+}
+void idle_timeouts(UINT32 dim_ms, UINT32 blank_ms, UINT32 off_ms){
+    idle_ms[IDLE_DIM - 1u] = dim_ms;
+    idle_ms[IDLE_BLANK - 1u] = blank_ms;
+    idle_ms[IDLE_OFF - 1u] = off_ms;
+}
+void restore_state(void){
+    if(
+        !persist_load(&saved, sizeof(saved)) || saved.version != SAVE_VERSION
+        || saved.radix_sel >= RADIX_COUNT || saved.dim_level >= DIM_LEVELS
+    )   return;
+    set_brightness(saved.dim_level);
+    cip.radix_sel = saved.radix_sel;
+    cip.radix = radix_cycle[saved.radix_sel];
+    cip.radix_shift = radix_shifts[saved.radix_sel];
+        // Only the digits of the result; the rest is taken as saved
+    if(saved.op1_is_result) store_result(saved.result);
+    cip.exp = saved.exp;
+    cip.magnitude = saved.magnitude;
+    cip.num_to_display = saved.num_to_display;
+    cip.state = saved.state;
+    cip.op1_is_result = saved.op1_is_result;
+    cip.error = saved.error;
+    if(cip.state == ENT_FIN_STATE && cip.result_len > MAX_DIGITS)
+        next_page();
+}
+void push_key(UINT8 row, UINT8 col){
+    UINT8 next = (key_head + 1u) & (KEY_QUEUE_LEN - 1u);
+    if(next == key_tail)    return;     // Full; drop the press
+    key_queue[key_head] = (row << 4) | col;
+    key_head = next;
+    TRACE(TRACE_KEY, row, col);
+    sched_post(calc_id);
+}
+BOOLEAN__ pop_key(UINT8* row, UINT8* col){
+    if(key_tail == key_head)    return FALSE__;
+    *row = (key_queue[key_tail] & ~KEY_REPEAT) >> 4;
+    *col = key_queue[key_tail] & (KEY_COL_ALL | KEY_REPEAT);
+    key_tail = (key_tail + 1u) & (KEY_QUEUE_LEN - 1u);
+    return TRUE__;
+}
+
+void serial_task(void){
+    UINT8 byte = 0x0;
+    char* end = NULL;
+    if(tele_ms && sched_expired(tele_due)){
+            // A line that does not fit is skipped, not waited for
+        tele_due += tele_ms;
+        if(sched_expired(tele_due)) tele_due = sched_now() + tele_ms;
+        end = reply;
+        *end++ = 'T';
+        *end++ = ' ';
+        end = text_dec(end, sched_now());
+        *end++ = ' ';
+        end = text_display(end);
+        end = text_counters(end);
+        *end++ = '\n';
+        serial_write(reply, end - reply);
+    }
+    for(;;){
+        if(!cmd_ready){
+            if(!serial_read(&byte)) return;
+            if(byte == '\r')   continue;
+            if(byte != '\n'){
+                if(cmd_len < CMD_LEN)   cmd_line[cmd_len++] = byte;
+                else                    cmd_long = TRUE__;
+                continue;
+            }
+            cmd_ready = TRUE__;
+            cmd_pos = 0x1;
+        }
+        if(!run_command())  return;
+        cmd_ready = cmd_long = FALSE__;
+        cmd_len = 0x0;
+    }
+}
+BOOLEAN__ run_command(void){
+    UINT8 row = 0x0, col = 0x0, pos = 0x1;
+    UINT32 value = 0x0;
+    struct trace_rec rec;
+    char* end = reply;
+    char cmd = cmd_len && !cmd_long ? cmd_line[0] : '?';
+        // Every reply fits once this much room is free
+    if(serial_space() < REPLY_LEN)  return FALSE__;
+        // Let earlier keys reach the calculator first
+    if(cmd != 'k' && calc_on && key_tail != key_head)   return FALSE__;
+
+    switch(cmd){
+        case 'k':
+                // Check every name before pressing anything
+            for(; cmd_pos == 0x1 && pos < cmd_len; ++pos){
+                if(cmd_line[pos] == ' ')    continue;
+                if(!key_by_name(cmd_line[pos], &row, &col)) cmd = '?';
+            }
+            for(; cmd != '?' && cmd_pos < cmd_len; ++cmd_pos){
+                if(!key_by_name(cmd_line[cmd_pos], &row, &col))  continue;
+                if(!calc_on){
+                    remote_start |= row == 0x0 && col == KEY_COL_ALL;
+                    continue;
                 }
+                    // Full; carry on from here next time
+                if(((key_head + 1u) & (KEY_QUEUE_LEN - 1u)) == key_tail)
+                    return FALSE__;
+                push_key(row, col);
+            }
+            *end++ = cmd;
+            break;
+        case 'd':
+            *end++ = 'd';
+            *end++ = ' ';
+            if(calc_on){
+                end = text_display(end);
+            } else {
+                *end++ = 'o';
+                *end++ = 'f';
+                *end++ = 'f';
+            }
+            break;
+        case 'p':
+            *end++ = 'p';
+            end = text_packet(end);
+            break;
+        case 'c':
+            *end++ = 'c';
+            end = text_counters(end);
+            break;
+        case 't':
+            for(; pos < cmd_len && cmd_line[pos] == ' '; ++pos);
+            for(; pos < cmd_len; ++pos){
+                if(cmd_line[pos] < '0' || cmd_line[pos] > '9')  break;
+                value = value*10u + (cmd_line[pos] - '0');
+            }
+            if(pos < cmd_len){
+                *end++ = '?';
                 break;
-            case ENT_INPUT:
-                if(
-                    cip.state != ENT_FIN_STATE &&
-                    cip.exp.index >= MAX_DIGITS
-                ){
-                    compute();
-                    cip.state = ENT_FIN_STATE;
-                    cip.num_to_display = 0u;
+            }
+            tele_ms = value;
+            tele_due = sched_now() + value;
+            *end++ = 't';
+            *end++ = ' ';
+            end = text_dec(end, value);
+            break;
+        case 'r':
+            *end++ = 'r';
+            for(
+                pos = 0x0;
+                pos < TRACE_PER_REPLY && trace_read(&rec, &value);
+                ++pos
+            ){
+                if(!pos){
+                    *end++ = ' ';
+                    end = text_dec(end, value);
                 }
-                break;
-            case NO_INPUT:  break;
-            default:        break;
-        }
-        display_dig(
-            200,
-            cip.exp.operand[cip.num_to_display*4u+MAX_DIGITS-1u-row],
-            row,
-            row == MAX_DIGITS-1-((cip.exp.index-1u)%MAX_DIGITS)+MAX_PRECISION,
-            (cip.exp.is_neg >> cip.num_to_display) & 0x1
-            );
-        display_dig(1, NULL_DIG, MAX_DIGITS-1u-row, FALSE__, FALSE__);
+                *end++ = ' ';
+                end = text_hex(end, rec.at, 4u);
+                end = text_hex(end, rec.kind, 2u);
+                end = text_hex(end, rec.arg, 2u);
+                end = text_hex(end, rec.value, 8u);
+            }
+            break;
+        default:
+            *end++ = '?';
+            break;
+    }
+    *end++ = '\n';
+    serial_write(reply, end - reply);
+    return TRUE__;
+}
+BOOLEAN__ key_by_name(char name, UINT8* row, UINT8* col){
+        // Layout as decode_input_type() reads it, by row*4+lsob(col)
+    static const char layout[] = "/+0-*987D654E321";
+        // Chords: name, row, columns
+    static const char chords[][3] = {
+        {'P', 0u, 0xF}, {'Q', 3u, 0xB}, {'T', 3u, 0xD},
+        {'B', 3u, 0x5}, {'F', 0u, 0x9}, {'S', 3u, 0x9}
+    };
+    UINT8 counter = 0x0;
+    for(; counter < sizeof(layout) - 1u; ++counter){
+        if(layout[counter] != name) continue;
+        *row = counter >> 2;
+        *col = 0x1 << (counter & 0x3);
+        return TRUE__;
+    }
+    for(counter = 0x0; counter < sizeof(chords)/sizeof(chords[0]); ++counter){
+        if(chords[counter][0] != name)  continue;
+        *row = chords[counter][1];
+        *col = chords[counter][2];
+        return TRUE__;
+    }
+    return FALSE__;
+}
+char* text_dec(char* at, UINT32 value){
+    char digits[10];
+    UINT8 len = 0x0;
+    do{
+        UINT32 tenth = divu10(value);
+        digits[len++] = '0' + (value - tenth*10u);
+        value = tenth;
+    } while(value);
+    while(len)  *at++ = digits[--len];
+    return at;
+}
+char* text_hex(char* at, UINT32 value, UINT8 digits){
+    static const char glyphs[] = "0123456789ABCDEF";
+    while(digits--) *at++ = glyphs[(value >> (digits*4u)) & 0xFu];
+    return at;
+}
+char* text_label(char* at, const char* label){
+    *at++ = ' ';
+    while(*label)   *at++ = *label++;
+    *at++ = '=';
+    return at;
+}
+char* text_field(char* at, const char* label, UINT32 value){
+    return text_dec(text_label(at, label), value);
+}
+char* text_display(char* at){
+    static const char glyphs[] = "0123456789AbCdEF";
+    UINT8 select = MAX_DIGITS, dig = 0x0;
+    BOOLEAN__ dot = FALSE__;
+    *at++ = '[';
+    *at++ = shown_sign() ? '-' : ' ';
+    while(select--){
+        dig = shown_dig(select, &dot);
+        *at++ = dig < 16u ? glyphs[dig] : ' ';
+        if(dot) *at++ = '.';
+    }
+    *at++ = ']';
+    return at;
+}
+char* text_packet(char* at){
+    static const char glyphs[] = "0123456789ABCDEF";
+    UINT8 counter = 0x0;
+    at = text_field(at, "state", cip.state);
+    at = text_field(at, "index", cip.exp.index);
+    at = text_field(at, "neg", cip.exp.is_neg);
+    at = text_field(at, "mag", cip.magnitude);
+    at = text_field(at, "show", cip.num_to_display);
+    at = text_field(at, "radix", cip.radix);
+    at = text_field(at, "err", cip.error);
+    at = text_field(at, "page", cip.page);
+        // Operator glyph, '_' for none
+    at = text_label(at, "op");
+    *at++ = cip.exp.op_code ? cip.exp.op_code : '_';
+        // Operand digits in storage order, '_' for an empty slot
+    at = text_label(at, "ops");
+    for(; counter < MAX_DIGITS*0x2; ++counter){
+        *at++ = cip.exp.operand[counter] < 16u
+            ? glyphs[cip.exp.operand[counter]] : '_';
     }
+        // Last result, most significant digit first
+    at = text_label(at, "res");
+    if(!cip.result_len) *at++ = '0';
+    for(counter = cip.result_len; counter > 0x0; --counter)
+        *at++ = glyphs[cip.result_dig[counter-0x1]];
+    return at;
+}
+char* text_counters(char* at){
+    UINT8 counter = 0x0;
+    for(; counter < PERF_COUNT; ++counter){
+        *at++ = ' ';
+        at = text_dec(at, perf[counter]);
+    }
+    return at;
 }
 
 void delete_last_entry(void){
@@ -346,6 +1473,7 @@ void delete_last_entry(void){
             cip.exp.operand[cip.exp.index] = NULL_DIG;
             cip.exp.is_neg = 0x0;
             cip.magnitude = 0x0;
+            cip.error = FALSE__;
             return;
         case 0x4:
             if(cip.state == ENT_OP_STATE){
@@ -365,102 +1493,488 @@ void delete_last_entry(void){
         default:
             --cip.exp.index;
             cip.exp.operand[cip.exp.index] = NULL_DIG;
+            if(cip.exp.index < MAX_DIGITS)  cip.op1_is_result = FALSE__;
             cip.state = ENT_NUM_STATE;
-                // Should never be 0 before decrement
-            --cip.magnitude;
+                // A full operand has already wrapped its magnitude to 0
+            cip.magnitude = cip.exp.index % MAX_DIGITS;
             break;
     }
 }
 
 void configure_ports(void){
-	delay_init();
-
-    port = (Port*)(0x41004400UL);
-    bankA = &(port->Group[0]);
-    bankB = &(port->Group[1]);
-        // Controls power to the keypad and SSDs. 0000 1111 0000
-    bankA->DIR.reg |= 0x000000F0;
-
-    bankB->DIR.reg
-            // Controls which segment turn on. 0000 1111 1111
-        |= 0x000000FF
-            // Controls sign indicator. 0010 0000 0000
-        |  0x00000200
-        ;
-    // Set high drive strength ?
-    unsigned short i = 0;
-    for(; i < 8; ++i){
-        bankA->PINCFG[i].reg |= (1<<6);
-    }
-
-        // For reading input from keypad. 1111 0000 0000 0000 0000 
-        //  Active high logic for input.
-    bankA->DIR.reg &= ~0x000F0000;
-    for(i = 16; i < 20; ++i){
-            // Enable input (bit 1).
-            //  Note that the pins are externally pulled low,
-            //  so disable pull up.
-        bankA->PINCFG[i].reg = PORT_PINCFG_INEN;
-    }
-        // Turn off extra dots
-    bankB->OUT.reg &= ~0x10;
+    clock_init();
+    hal_init();
+    serial_init();
+    persist_init();
+    set_brightness(DIM_LEVELS - 1u);
+}
+
+void set_brightness(UINT8 level){
+    dim_level = level % DIM_LEVELS;
+    hal_dim_set(dim_duty[dim_level]);
 }
 
 BOOLEAN__ compute(){
         // Retrieve the actual operands
-    INT32 op1=0x0, op2=0x0;
-    UINT32 hold = 0x0;
+    INT64 op1=0x0, op2=0x0;
     UINT8 counter = MAX_DIGITS;
-    INT32 factor = 1;
-        // Need to use two separate for loop due to factor being dynamic
-    for(; counter > 0x0; --counter){
-        hold = cip.exp.operand[counter - 0x1];
-        if(hold == NULL_DIG) continue;
-        op1 += hold * factor;
-        factor *= 10;
-    }
-    for(counter = MAX_DIGITS, factor = 1; counter > 0x0; --counter){
-        hold = cip.exp.operand[counter - 0x1 + MAX_DIGITS];
-        if(hold == NULL_DIG) continue;
-        op2 += hold * factor;
-        factor *= 10;
-    }
-    op1 *= (INT32)(cip.exp.is_neg & 0x1)*(-2) + 1;
-    op2 *= (INT32)(cip.exp.is_neg & 0x2)*(-2) + 1;
-
-    switch(cip.exp.op_code){
-        case ADD_GLYPH: op1 += op2;         break;
-        case SUB_GLYPH: op1 -= op2;         break;
-        case MUL_GLYPH: op1 *= op2;         break;
-        case DIV_GLYPH: op1 = op1 / op2;    break;
-        default:                            return FALSE__;
-    }
+    BOOLEAN__ over = FALSE__;
+    if(cip.exp.op_code == 0u)   return FALSE__;
+        // A chained result is wider than what operand 1 can show
+    op1 = cip.op1_is_result
+        ? (INT64)cip.result : (INT64)join_digits(cip.exp.operand, MAX_DIGITS);
+    op2 = join_digits(cip.exp.operand + MAX_DIGITS, MAX_DIGITS);
+    if(cip.exp.is_neg & 0x1)    op1 = -op1;
+    if(cip.exp.is_neg & 0x2)    op2 = -op2;
+
+    op1 = compute_wide(cip.exp.op_code, op1, op2, &over);
+    if(over)    return TRUE__;
 
     if(op1 < 0){
         cip.exp.is_neg |= 0x1;
-        op2 = (op1 *= -1);
+        op1 = -op1;
     } else {
         cip.exp.is_neg = 0x0;
-        op2 = op1;
     }
         // Reset some values and store the result in operand 1's slot
-    for(counter = MAX_DIGITS; counter > 0x0; --counter, op1 /= 10){
-        cip.exp.operand[counter-0x1] = op1 % 10;
+    for(counter = MAX_DIGITS; counter > 0x0; --counter)
         cip.exp.operand[counter-0x1+MAX_DIGITS] = NULL_DIG;
+    cip.magnitude = cip.exp.index = store_result(op1);
+    cip.exp.op_code = 0u;
+    cip.exp.is_neg &= ~(0x2);
+
+    return FALSE__;
+}
+
+INT64 compute_wide(UINT8 op_code, INT64 op1, INT64 op2, BOOLEAN__* over){
+        // Multiplication, division and shifts work on magnitudes, the rest
+        //  in two's complement. Either way the result must come back within
+        //  WIDE_MAX.
+    BOOLEAN__ neg1 = op1 < 0, neg2 = op2 < 0;
+    UINT64 mag1 = neg1 ? 0u - (UINT64)op1 : (UINT64)op1;
+    UINT64 mag2 = neg2 ? 0u - (UINT64)op2 : (UINT64)op2;
+    UINT64 mag = 0x0;
+    INT64 res = 0x0;
+    UINT8 counter = 0x0;
+    *over = FALSE__;
+
+    switch(op_code){
+            // Overflow iff both inputs have a sign the result does not
+        case ADD_GLYPH:
+            res = (INT64)((UINT64)op1 + (UINT64)op2);
+            *over = ((op1 ^ res) & (op2 ^ res)) < 0;
+            break;
+        case SUB_GLYPH:
+            res = (INT64)((UINT64)op1 - (UINT64)op2);
+            *over = ((op1 ^ op2) & (op1 ^ res)) < 0;
+            break;
+        case MUL_GLYPH:
+                // Keep the narrow factor on the right. If neither is
+                //  narrow the product needs more than 64 bits.
+            if(mag2 >> 32){
+                mag = mag1;
+                mag1 = mag2;
+                mag2 = mag;
+            }
+            if(mag2 >> 32){
+                *over = mag1 != 0u;
+                mag = 0u;
+            } else {
+                mag = mul_wide(mag1, (UINT32)mag2, over);
+            }
+            res = neg1 != neg2 ? -(INT64)(mag & WIDE_MAX) : (INT64)mag;
+            *over |= mag > WIDE_MAX;
+            return res;
+        case DIV_GLYPH:
+            if(mag2 == 0u){
+                *over = TRUE__;
+                return 0;
+            }
+            if(mag2 >> 32){
+                    // Entered operands never get here. Plain restoring
+                    //  division, one quotient bit per step.
+                for(mag = 0u, counter = 64u; counter > 0x0; --counter){
+                    mag = (mag << 1) | (mag1 >> 63);
+                    mag1 <<= 1;
+                    if(mag >= mag2){
+                        mag -= mag2;
+                        mag1 |= 0x1;
+                    }
+                }
+            } else {
+                div_wide(&mag1, (UINT32)mag2);
+            }
+            return neg1 != neg2 ? -(INT64)mag1 : (INT64)mag1;
+        case AND_GLYPH: res = op1 & op2;    break;
+        case OR_GLYPH:  res = op1 | op2;    break;
+        case XOR_GLYPH: res = op1 ^ op2;    break;
+            // A left shift is multiplication by a power of two, so it
+            //  overloads as soon as a significant bit would be lost.
+        case SHL_GLYPH:
+            if(neg2 || mag2 > 62u || mag1 > (WIDE_MAX >> mag2)){
+                *over = mag1 != 0u;
+                return 0;
+            }
+            mag = mag1 << mag2;
+            return neg1 ? -(INT64)mag : (INT64)mag;
+        case SHR_GLYPH:
+            if(neg2 || mag2 > 62u)  res = neg1 ? -1 : 0;
+            else                    res = op1 >> mag2;
+            break;
+        default:
+            return op1;
     }
-    cip.magnitude = cip.exp.index = MAX_DIGITS;
-    while(cip.exp.operand[0] == 0x0 && cip.exp.index > 0x0){
-        for(counter = 0x1; counter < MAX_DIGITS; ++counter){
-            cip.exp.operand[counter-1] = cip.exp.operand[counter];
-            cip.exp.operand[counter] = NULL_DIG;
+        // The one two's complement value without a magnitude in range
+    *over |= res < -(INT64)WIDE_MAX;
+    return res;
+}
+
+UINT64 mul32x32(UINT32 a, UINT32 b){
+    UINT32 a_lo = a & 0xFFFFu, a_hi = a >> 16;
+    UINT32 b_lo = b & 0xFFFFu, b_hi = b >> 16;
+    UINT32 lo = a_lo * b_lo, hi = a_hi * b_hi;
+    UINT32 mid = a_lo * b_hi, cross = a_hi * b_lo;
+        // Each carry is worth 2^16 in the middle and 2^32 at the top
+    mid += cross;
+    if(mid < cross) hi += 0x10000u;
+    cross = mid << 16;
+    lo += cross;
+    if(lo < cross)  ++hi;
+    hi += mid >> 16;
+    return ((UINT64)hi << 32) | lo;
+}
+
+UINT64 mul_wide(UINT64 a, UINT32 b, BOOLEAN__* over){
+    UINT64 lo = mul32x32((UINT32)a, b);
+    UINT64 hi = mul32x32((UINT32)(a >> 32), b);
+    *over = (hi >> 32) != 0u;
+    hi <<= 32;
+    lo += hi;
+    if(lo < hi) *over = TRUE__;
+    return lo;
+}
+
+UINT32 div64x32(UINT32 hi, UINT32 lo, UINT32 d, UINT32* rem){
+    UINT8 counter = 32u;
+    UINT32 carry = 0x0;
+        // While hi is zero, leading zeros of lo only shift zeros into it
+    for(; counter > 0x0 && !hi && !(lo >> 24); counter -= 8u)   lo <<= 8;
+    for(; counter > 0x0; --counter){
+        carry = hi >> 31;
+        hi = (hi << 1) | (lo >> 31);
+        lo <<= 1;
+        if(carry || hi >= d){
+            hi -= d;
+            lo |= 0x1;
         }
-        --cip.magnitude;
-        --cip.exp.index;
     }
-    cip.exp.op_code = 0u;
-    cip.exp.is_neg &= ~(0x2);
+    *rem = hi;
+    return lo;
+}
+
+UINT32 div_wide(UINT64* n, UINT32 d){
+        // Long division in base 2^32, high word first
+    UINT32 hi = (UINT32)(*n >> 32), rem = hi, quot = 0x0;
+    if(hi >= d) quot = div64x32(0u, hi, d, &rem);
+    *n = ((UINT64)quot << 32) | div64x32(rem, (UINT32)*n, d, &rem);
+    return rem;
+}
+
+void mac_limbs(
+    UINT32* acc, UINT8 len, const UINT32* a, UINT8 a_len, UINT32 b
+){
+        // At most a full product and two carries, which still fits
+    UINT64 part = 0x0;
+    UINT8 counter = 0x0;
+    for(; counter < len; ++counter){
+        if(counter < a_len) part += mul32x32(a[counter], b);
+        part += acc[counter];
+        acc[counter] = (UINT32)part;
+        part >>= 32;
+    }
+}
+
+void sub_limbs(UINT32* acc, const UINT32* b, UINT8 len){
+    UINT64 part = 0x0;
+    UINT32 borrow = 0x0;
+    for(; len > 0x0; --len, ++acc, ++b){
+        part = (UINT64)*acc - *b - borrow;
+        *acc = (UINT32)part;
+        borrow = (UINT32)(part >> 63);
+    }
+}
+
+UINT32 div_limbs(UINT32* limbs, UINT8 count, UINT32 d){
+        // Long division in base 2^32, high limb first
+    UINT32 rem = 0x0;
+    while(count--)  limbs[count] = div64x32(rem, limbs[count], d, &rem);
+    return rem;
+}
+
+UINT8 store_result(UINT64 value){
+    UINT32 chunk = 0x0, quot = 0x0;
+    UINT8 used = 0x0, counter = 0x0;
+    cip.result = value;
+    cip.op1_is_result = TRUE__;
+        // Powers of two shift straight through. Decimal comes off in
+        //  chunks of nine digits, so only one wide division is needed per
+        //  chunk and the digits themselves go through divu10().
+    for(cip.result_len = 0x0; value; ){
+        if(cip.radix_shift){
+            cip.result_dig[cip.result_len++] =
+                (UINT32)value & (cip.radix - 1u);
+            value >>= cip.radix_shift;
+            continue;
+        }
+        if(value >= 1000000000u){
+            chunk = div_wide(&value, 1000000000u);
+        } else {
+            chunk = (UINT32)value;
+            value = 0u;
+        }
+        for(counter = 9u; counter > 0x0 && (chunk || value); --counter){
+            quot = divu10(chunk);
+            cip.result_dig[cip.result_len++] = chunk - quot * 10u;
+            chunk = quot;
+        }
+    }
+        // Operand 1 is big endian and left aligned
+    used = cip.result_len < MAX_DIGITS ? cip.result_len : MAX_DIGITS;
+    for(counter = 0x0; counter < MAX_DIGITS; ++counter){
+        cip.exp.operand[counter] =
+            counter < used ? cip.result_dig[used-0x1-counter] : NULL_DIG;
+    }
+    return used;
+}
+
+void show_value(INT64 value){
+    reset_info_pack();
+    if(value < 0){
+        cip.exp.is_neg = 0x1;
+        value = -value;
+    }
+    cip.magnitude = cip.exp.index = store_result((UINT64)value);
+    cip.state = ENT_FIN_STATE;
+    if(cip.result_len > MAX_DIGITS) next_page();
+}
+
+BOOLEAN__ shown_value(INT64* dest){
+    UINT8 which = cip.num_to_display;
+    const UINT8* digits = cip.exp.operand + which*MAX_DIGITS;
+    UINT64 mag = 0x0;
+    if(cip.error)   return FALSE__;
+    if(!which && cip.op1_is_result) mag = cip.result;
+    else if(*digits == NULL_DIG)    return FALSE__;
+    else    mag = join_digits(digits, MAX_DIGITS);
+    *dest = (cip.exp.is_neg >> which) & 0x1 ? -(INT64)mag : (INT64)mag;
+    return TRUE__;
+}
+
+void next_page(void){
+        // Four digits to a window
+    cip.page = cip.page ? cip.page - 1u : (cip.result_len - 1u) >> 2;
+    cip.page_due = sched_now() + PAGE_MS;
+}
+
+void sigma_clear(void){
+    sigma.count = 0x0;
+    sigma.sum = 0x0;
+    sigma.sq_lo = 0x0;
+    sigma.sq_hi = 0x0;
+    sigma.low = sigma.high = 0x0;
+}
+
+BOOLEAN__ sigma_add(INT64 value){
+    UINT32 mag = value < 0 ? 0u - (UINT32)value : (UINT32)value;
+    UINT64 sq = 0x0;
+    if(value > SIGMA_LIMIT || value < -SIGMA_LIMIT) return FALSE__;
+    if(sigma.count == SIGMA_COUNT_MAX)  return FALSE__;
+    sq = mul32x32(mag, mag);
+    sigma.sq_lo += sq;
+    if(sigma.sq_lo < sq)    ++sigma.sq_hi;
+    sigma.sum += value;
+    if(!sigma.count || value < sigma.low)   sigma.low = (INT32)value;
+    if(!sigma.count || value > sigma.high)  sigma.high = (INT32)value;
+    ++sigma.count;
+    return TRUE__;
+}
+
+UINT64 sigma_variance(void){
+        // (count * sum of squares - sum^2) / (count * (count - 1)), with
+        //  half the divisor added first to round. Every term fits 128 bits.
+    UINT32 n = sigma.count;
+    UINT64 mag = sigma.sum < 0 ? 0u - (UINT64)sigma.sum : (UINT64)sigma.sum;
+    UINT64 half = mul32x32(n, n - 1u) >> 1;
+    UINT32 sq[3] = {
+        (UINT32)sigma.sq_lo, (UINT32)(sigma.sq_lo >> 32), sigma.sq_hi
+    };
+    UINT32 sum[2] = {(UINT32)mag, (UINT32)(mag >> 32)};
+    UINT32 add[2] = {(UINT32)half, (UINT32)(half >> 32)};
+    UINT32 num[4] = {0x0}, sum_sq[4] = {0x0};
+    mac_limbs(num, 4u, sq, 3u, n);
+    mac_limbs(sum_sq, 4u, sum, 2u, sum[0]);
+    mac_limbs(sum_sq + 1, 3u, sum, 2u, sum[1]);
+    sub_limbs(num, sum_sq, 4u);
+    mac_limbs(num, 4u, add, 2u, 0x1u);
+    div_limbs(num, 4u, n);
+    div_limbs(num, 4u, n - 1u);
+    return ((UINT64)num[1] << 32) | num[0];
+}
+
+BOOLEAN__ sigma_get(UINT8 stat, INT64* dest){
+    UINT64 mag = 0x0;
+    UINT32 rem = 0x0;
+    if(stat == SIGMA_N){
+        *dest = sigma.count;
+        return TRUE__;
+    }
+    if(!sigma.count)    return FALSE__;
+    switch(stat){
+        case SIGMA_SUM:
+            *dest = sigma.sum;
+            break;
+        case SIGMA_MEAN:
+                // Halves round away from zero
+            mag = sigma.sum < 0 ? 0u - (UINT64)sigma.sum : (UINT64)sigma.sum;
+            rem = div_wide(&mag, sigma.count);
+            if(rem >= sigma.count - rem)    ++mag;
+            *dest = sigma.sum < 0 ? -(INT64)mag : (INT64)mag;
+            break;
+        case SIGMA_VAR:
+            if(sigma.count < 2u)    return FALSE__;
+            *dest = (INT64)sigma_variance();
+            break;
+        case SIGMA_LOW:
+            *dest = sigma.low;
+            break;
+        default:
+            *dest = sigma.high;
+            break;
+    }
+    return TRUE__;
+}
+
+void apply_sigma(UINT8 key){
+    INT64 value = 0x0;
+    BOOLEAN__ ok = TRUE__;
+    switch(key){
+        case SIGMA_ADD:
+                // Nothing on show, nothing to add
+            if(!shown_value(&value))    return;
+            ok = sigma_add(value);
+            sigma_sel = SIGMA_N;
+            break;
+        case SIGMA_NEXT:
+            sigma_sel = (sigma_sel + 1u) % SIGMA_STATS;
+            break;
+        default:
+            sigma_clear();
+            sigma_sel = SIGMA_N;
+            break;
+    }
+    if(ok && sigma_get(sigma_sel, &value)){
+        show_value(value);
+        return;
+    }
+    reset_info_pack();
+    cip.error = TRUE__;
+    cip.state = ENT_FIN_STATE;
+}
+
+UINT32 divu10(UINT32 n){
+        // q is an underestimate of n/10 by at most one; the remainder
+        //  tells whether to round it up, again without a branch.
+    UINT32 q = (n >> 1) + (n >> 2);
+    q += q >> 4;
+    q += q >> 8;
+    q += q >> 16;
+    q >>= 3;
+    UINT32 r = n - ((q << 3) + (q << 1));
+    return q + ((r + 6u) >> 4);
+}
+
+UINT32 join_digits(const UINT8* digits, UINT8 count){
+    UINT32 value = 0x0;
+    for(; count > 0x0 && *digits != NULL_DIG; --count, ++digits)
+        value = value * cip.radix + *digits;
+    return value;
+}
+
+UINT32 div_radix(UINT32 value){
+        // Both quotients are computed every time, so conversions take the
+        //  same path for every radix and every value.
+    UINT32 is_dec = -(UINT32)(cip.radix == 10u);
+    return (divu10(value) & is_dec) | ((value >> cip.radix_shift) & ~is_dec);
+}
+
+void split_digits(UINT32 value, UINT8* digits, UINT8 count){
+    UINT32 quot = 0x0;
+    for(; count > 0x0; --count){
+        quot = div_radix(value);
+        digits[count-0x1] = value - quot * cip.radix;
+        value = quot;
+    }
+}
+
+UINT8 store_value(UINT32 value, UINT8* digits){
+    UINT8 used = 0x0, counter = 0x0;
+    UINT32 left = value;
+    for(; left && used < MAX_DIGITS; ++used)
+        left = div_radix(left);
+    split_digits(value, digits, used);
+    for(counter = used; counter < MAX_DIGITS; ++counter)
+        digits[counter] = NULL_DIG;
+    return used;
+}
+
+BOOLEAN__ set_radix(UINT8 sel){
+    UINT32 op1 = join_digits(cip.exp.operand, MAX_DIGITS);
+    UINT32 op2 = join_digits(cip.exp.operand + MAX_DIGITS, MAX_DIGITS);
+    UINT32 limit = 1u;
+    UINT8 counter = MAX_DIGITS;
 
-    return op2 >= factor*0xA;
+    sel %= RADIX_COUNT;
+    for(; counter > 0x0; --counter) limit *= radix_cycle[sel];
+    if((op1 >= limit && !cip.op1_is_result) || op2 >= limit)
+        return FALSE__;
+
+    cip.radix_sel = sel;
+    cip.radix = radix_cycle[sel];
+    cip.radix_shift = radix_shifts[sel];
+    op1 = cip.op1_is_result
+        ? store_result(cip.result) : store_value(op1, cip.exp.operand);
+    cip.page = 0x0;
+    if(cip.op1_is_result && cip.result_len > MAX_DIGITS) next_page();
+    op2 = store_value(op2, cip.exp.operand + MAX_DIGITS);
+
+        // The digit counts changed, so redo the entry bookkeeping for
+        //  whichever operand is in use.
+    switch(cip.state){
+        case ENT_NUM_STATE:
+            if(cip.exp.index < MAX_DIGITS){
+                cip.exp.index = cip.magnitude = op1;
+            } else {
+                cip.magnitude = op2;
+                cip.exp.index = MAX_DIGITS + op2;
+            }
+            if(cip.magnitude == MAX_MAGNITUDE){
+                cip.magnitude = 0u;
+                cip.state = ENT_OP_STATE;
+            }
+            break;
+        case ENT_OP_STATE:
+            cip.exp.index = op1;
+            if(op1 < MAX_MAGNITUDE){
+                cip.magnitude = op1;
+                cip.state = ENT_NUM_STATE;
+            }
+            break;
+        case ENT_FIN_STATE:
+            cip.exp.index = cip.magnitude = op1;
+            break;
+        default:    break;
+    }
+    return TRUE__;
 }
 
 BOOLEAN__ store_dig(UINT8 new_dig){
@@ -472,6 +1986,10 @@ BOOLEAN__ store_dig(UINT8 new_dig){
             reset_info_pack();
         case ENT_NUM_STATE:
             // Program is ready to accept a new digit.
+            if (new_dig >= cip.radix){
+                // Not a digit of the current radix
+                return FALSE__;
+            }
             if (cip.magnitude == MAX_MAGNITUDE){
                 // There were already MAX_MAGNITUDE digits stored
                 return FALSE__;
@@ -481,6 +1999,7 @@ BOOLEAN__ store_dig(UINT8 new_dig){
                 return TRUE__;
             }
             cip.exp.operand[cip.exp.index] = new_dig;
+            if(cip.exp.index < MAX_DIGITS)  cip.op1_is_result = FALSE__;
                 // Update magnitude and index.
             ++cip.magnitude;
             ++cip.exp.index;
@@ -503,6 +2022,8 @@ BOOLEAN__ store_dig(UINT8 new_dig){
 BOOLEAN__ store_op(UINT8 new_op){
     switch (cip.state){
         case ENT_OP_STATE:
+                // A full second operand leaves no room for a third
+            if (cip.exp.index > MAX_DIGITS)    return FALSE__;
             cip.exp.op_code = new_op;
             cip.state = ENT_NUM_STATE;
             cip.num_to_display = 0x1;
@@ -515,6 +2036,7 @@ BOOLEAN__ store_op(UINT8 new_op){
                 return FALSE__;
             }
         case ENT_FIN_STATE: // Allow expression chaining
+            if(cip.error)   return FALSE__;
             cip.state = ENT_NUM_STATE;
             cip.exp.op_code = new_op;
             cip.exp.index = MAX_DIGITS;
@@ -541,6 +2063,18 @@ INPUT_TYPE decode_input_type(UINT8* i_code, UINT8 row, UINT8 col){
             if(row != 3)    break;
             *i_code = TERMINATION_KEY2;     // Terminate the test program
             return TERM_INPUT;
+        case 0x5:
+            if(row != 3)    break;
+            *i_code = 0;                    // Cycle display brightness
+            return BRIGHT_INPUT;
+        case 0x9:
+            if(row == 3){
+                *i_code = 0;                // Performance counters
+                return STATS_INPUT;
+            }
+            if(row != 0)    break;
+            *i_code = 0;                    // Second function prefix
+            return FN_INPUT;
         case 0x0:
             return NO_INPUT;
         default:    break;
@@ -579,6 +2113,36 @@ INPUT_TYPE decode_input_type(UINT8* i_code, UINT8 row, UINT8 col){
     }
 }
 
+INPUT_TYPE second_function(INPUT_TYPE in_type, UINT8* i_code){
+    switch(in_type){
+        case DIG_INPUT:
+            if(
+                *i_code == SIGMA_ADD || *i_code == SIGMA_NEXT
+                || *i_code == SIGMA_CLEAR
+            )   return SIGMA_INPUT;
+            // 1 - 6 enter the hexadecimal digits A - F
+            if(*i_code < 0x1 || *i_code > 0x6)  return NO_INPUT;
+            *i_code += 0x9;
+            return DIG_INPUT;
+        case OP_INPUT:
+            switch(*i_code){
+                case ADD_GLYPH: *i_code = OR_GLYPH;     break;
+                case MUL_GLYPH: *i_code = AND_GLYPH;    break;
+                case SUB_GLYPH: *i_code = XOR_GLYPH;    break;
+                case DIV_GLYPH: *i_code = SHL_GLYPH;    break;
+                default:                                return NO_INPUT;
+            }
+            return OP_INPUT;
+        case DEL_INPUT:
+            *i_code = SHR_GLYPH;
+            return OP_INPUT;
+        case ENT_INPUT:
+            return RADIX_INPUT;
+        default:    // Including a second FN, which cancels the first
+            return NO_INPUT;
+    }
+}
+
 UINT32 find_lsob(UINT32 target){
     UINT32 toreturn = 0u;
     while(!(target & 0x1)){
@@ -588,87 +2152,54 @@ UINT32 find_lsob(UINT32 target){
     return toreturn;
 }
 
+    // Lit segments of the hexadecimal digits. The comments give the
+    //  active low pattern on the bus.
+static const UINT8 seg_glyphs[16] HAL_RAMDATA = {
+            //  GEF DCBA
+    0x3F,   // 0100 0000    0
+    0x06,   // 0111 1001    1
+    0x5B,   // 0010 0100    2
+    0x4F,   // 0011 0000    3
+    0x66,   // 0001 1001    4
+    0x6D,   // 0001 0010    5
+    0x7D,   // 0000 0010    6
+    0x07,   // 0111 1000    7
+    0x7F,   // 0000 0000    8
+    0x6F,   // 0001 0000    9
+    0x77,   // 0000 1000    A
+    0x7C,   // 0000 0011    b
+    0x39,   // 0100 0110    C
+    0x5E,   // 0010 0001    d
+    0x79,   // 0000 0110    E
+    0x71    // 0000 1110    F
+};
+
 void display_dig(
     UINT32 add_delay, UINT8 num, UINT8 select,
     BOOLEAN__ show_dot, BOOLEAN__ show_sign
 ){
-        // Active low logic
-    bankB->OUT.reg |= 0x000000FF;
-        // Provide power to one specific SSD
-    bankA->OUT.reg |= 0x000000F0;
-    bankA->OUT.reg &= ~(1 << (select + 4u));
-    switch(num){
-                //  GEF DCBA
-        case 0: // 0100 0000
-            bankB->OUT.reg &= ~0xBF;
-            break;
-        case 1: // 0111 1001
-            bankB->OUT.reg &= ~0x86;
-            break;
-        case 2: // 0010 0100
-            bankB->OUT.reg &= ~0xDB;
-            break;
-        case 3: // 0011 0000
-            bankB->OUT.reg &= ~0xCF;
-            break;
-        case 4: // 0001 1001
-            bankB->OUT.reg &= ~0xE6;
-            break;
-        case 5: // 0001 0010
-            bankB->OUT.reg &= ~0xED;
-            break;
-        case 6: // 0000 0010
-            bankB->OUT.reg &= ~0xFD;
-            break;
-        case 7: // 0111 1000
-            bankB->OUT.reg &= ~0x87;
-            break;
-        case 8: // 0000 0000
-            bankB->OUT.reg &= ~0x7F;
-            break;
-        case 9: // 0001 0000
-            bankB->OUT.reg &= ~0xEF;
-            break;
-        case 10: // 0000 1000
-            bankB->OUT.reg &= ~0xF7;
-            break;
-        case 11: // 0000 0011
-            bankB->OUT.reg &= ~0xFC;
-            break;
-        case 12: // 0100 0110
-            bankB->OUT.reg &= ~0xB9;
-            break;
-        case 13: // 0010 0001
-            bankB->OUT.reg &= ~0xDE;
-            break;
-        case 14: // 0000 0110
-            bankB->OUT.reg &= ~0xF9;
-            break;
-        case 15: // 0000 1110
-            bankB->OUT.reg &= ~0xF1;
-            break;
-        default:    // Non-hexadecimal digit or negative
-            bankB->OUT.reg |= 0xFF;
-            show_dot = FALSE__;
-            break;
-    }
-    if(show_dot)    bankB->OUT.reg &= ~0x00000080;
-    else            bankB->OUT.reg |=  0x00000080;
-    if(show_sign)   bankB->OUT.reg &= ~0x00000200;
-    else            bankB->OUT.reg |=  0x00000200;
-    delay_us(add_delay);
+        // Work out the whole pattern first, so the port only ever sees
+        //  the final one
+    UINT32 segs = 0x0;
+    if(num < 16u)                   segs = seg_glyphs[num];
+    else if(num != BLANK_DIG)       show_dot = FALSE__;
+    if(show_dot)    segs |= SEG_DOT_MASK;
+        // Provide power to one specific SSD. The port drives every enable
+        //  off and the dimmer's waveform output takes over the selected one.
+    hal_dig_show(select, segs, show_sign);
+    if(add_delay)   sched_sleep_us(add_delay);
 }
 
 void check_key(UINT8* row_dest, UINT8* col_dest){
     if(IS_NULL(row_dest) || IS_NULL(col_dest))  return;
-    static UINT8 cur_row = 0u;
+    static HAL_UNIT UINT8 cur_row = 0u;
     // Provide power to one specific row
-    bankA->OUT.reg |= 0x000000F0;
-    bankA->OUT.reg &= ~(1u << (4u + cur_row));
+    hal_row_drive(cur_row);
         // Extract the four bits we're interested in from
         //   the keypad.
     *col_dest = debounce_keypress();
     *row_dest = cur_row;
+    if(*col_dest)   TRACE(TRACE_KEY, cur_row, *col_dest);
 
         // Prepare for the next row. If we were on the last
         //  row, cycle back to the first row.
@@ -679,14 +2210,34 @@ void check_key(UINT8* row_dest, UINT8* col_dest){
 }
 
 void set_initial_state(void){
-        // Active low logic
-    bankA->OUT.reg |= 0x000000F0;
-    bankB->OUT.reg |= 0x000000FF;
-    bankB->OUT.reg |= 0x200;
+    hal_dig_release();
+    hal_dig_all_off();
+    hal_seg_blank();
+    hal_sign_set(FALSE__);
+
+    reset_calculator();
+}
+
+void reset_calculator(void){
+    cip.radix_sel = 0u;
+    cip.radix = radix_cycle[0];
+    cip.radix_shift = radix_shifts[0];
+    fn_pending = FALSE__;
 
     reset_info_pack();
 }
 
+void reset_unit(void){
+    UINT8 counter = PERF_COUNT;
+    for(; counter > 0x0; --counter)
+        perf[counter-0x1] = 0x0;
+    stat_sel = stat_page = 0x0;
+    sigma_clear();
+    sigma_sel = SIGMA_N;
+
+    reset_calculator();
+}
+
 void reset_info_pack(void){
     // Initialize packet information
         // Decrementing migt be faster like in other ARM architectures?
@@ -696,44 +2247,19 @@ void reset_info_pack(void){
     cip.exp.index = cip.exp.op_code = cip.exp.is_neg = 0u;
     cip.magnitude = cip.num_to_display = 0u;
     cip.state = ENT_NUM_STATE;
-}
-
-void shutdown(void){
-#define LIGHT_DELAY__ 5000
-    UINT8 counter_last = 7;
-    for(; counter_last > 0; --counter_last){
-        display_dig(LIGHT_DELAY__, 1, 3, FALSE__, FALSE__);
-        display_dig(LIGHT_DELAY__, 3, 2, FALSE__, FALSE__);
-        display_dig(LIGHT_DELAY__, 3, 1, FALSE__, FALSE__);
-        display_dig(LIGHT_DELAY__, 7, 0, FALSE__, FALSE__);
-    }
-#undef LIGHT_DELAY__
-
-    set_initial_state();
-    blink_rdy(333);
+    cip.result = cip.result_len = cip.page = 0u;
+    cip.op1_is_result = cip.error = FALSE__;
 }
 
 void blink_rdy(UINT32 add_delay){
-    // Blink three times to indicate shutdown
-    bankA->DIR.reg |= (1<14u);
-    UINT8 counter = 0x0;
-    bankB->OUT.reg = 0xFF;
-    for(; counter < 3; ++counter){
-        bankA->OUT.reg |= (1<<14u);
-        bankB->OUT.reg &= ~0x200;
-        delay_ms(add_delay);
-        bankA->OUT.reg &= ~(1<<14u);
-        bankB->OUT.reg |= 0x200;
-        delay_ms(add_delay);
-    }
-    bankB->OUT.reg = 0xFF;
+    anim_start(ANIM_BLINK, CHECK_BLINKS, add_delay);
+    sched_run();
 }
-
 UINT8 debounce_keypress(void){
     // Triggered the instant the first key press is detected
     //  Returns the resulting hex number
 
-    UINT8 toreturn = (bankA->IN.reg >> 16u) & 0xF;
+    UINT8 toreturn = hal_key_cols();
 
         // Check if more than one button in a row was pressed.
         //  If so, checking for glitches is no longer important.
@@ -745,34 +2271,36 @@ UINT8 debounce_keypress(void){
     }
 
     if(!toreturn)   return 0x0;
-#define MAX_JITTER  5
-#define MAX_JITTER2 1000
-#define RELEASE_LIM 7500
-
-    // First, read up to MAX_JITTER times to swallow spikes as button is
-    //  pressed. If no key press was detected in this time, the noise is
-    //  not from a button press.
-    for(counter = 0x0; counter < MAX_JITTER; ++counter){
-        if(!((bankA->IN.reg >> 16u) & 0xF))    return 0x0;
+    // Times on the timer, so they hold at any CPU clock
+#define MAX_JITTER_US   100u
+#define QUIET_US        20000u
+#define RELEASE_LIM_US  150000u
+
+    // First, keep reading for MAX_JITTER_US to swallow spikes as button
+    //  is pressed. If the key drops out in this time, the noise is not
+    //  from a button press.
+    UINT32 now = sched_now_us(), until = now + MAX_JITTER_US;
+    while(!sched_expired_us(until)){
+        if(hal_key_cols())  continue;
+        return 0x0;
     }
 
     // Now swallow the spikes as the button is released. Do not exit
-    //  until the spikes are no longer detected after MAX_JITTER reads.
-    //  If the user is holding down the button, release manually based
-    //  on RELEASE_LIM.
-    volatile UINT32 release = 0x0;
-    for(
-        counter = 0x0;
-        counter < MAX_JITTER2 && release < RELEASE_LIM;
-        ++counter, ++release
-    ){
-        if((bankA->IN.reg >> 16u) & 0xF)    counter = 0x0;
+    //  until no spike has been seen for QUIET_US. If the user is holding
+    //  down the button, release manually after RELEASE_LIM_US.
+    now = sched_now_us();
+    until = now + QUIET_US;
+    UINT32 release = now + RELEASE_LIM_US;
+    while(!sched_expired_us(until)){
+        if(sched_expired_us(release))   break;
+        if(hal_key_cols())  until = sched_now_us() + QUIET_US;
     }
 
     return toreturn;
 
-#undef MAX_JITTER
-#undef RELEASE_LIM
+#undef MAX_JITTER_US
+#undef QUIET_US
+#undef RELEASE_LIM_US
 }
 
 /**********   End function definitions      **********/
\ No newline at end of file
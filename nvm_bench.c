@@ -0,0 +1,160 @@
+    // Wear and power loss recovery of the flash record store in persist.c,
+    //  run on the host simulator's flash model.
+    //
+    //  Build:  cc -DHOST_SIM -O2 -o nvm_bench
+    //              nvm_bench.c host_sim.c main.c sched.c serial.c
+    //              clock.c persist.c trace.c
+    //  Usage:  nvm_bench [saves [cuts]]
+    //
+    // Three parts, each on factory fresh flash:
+    //  - wear: saves records that all differ, with a power cycle every
+    //    so often, and reports the erases each row took. Saving in place
+    //    would erase one row on every save.
+    //  - power loss: cuts the power at a random byte of a random save,
+    //    erase or write, then powers up and checks that the record read
+    //    back is the last one saved in full, and that saving goes on.
+    //  - firmware: keys 12+34E into the calculator, turns it off with Q
+    //    and powers it up again, and shows what it comes back with.
+
+#include "hal.h"
+#include "persist.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_SAVES         100000u
+#define BENCH_CUTS          10000u
+#define BENCH_SEED          0x2545F491u
+    // Saves between power cycles, to keep virtual time within bounds
+#define SAVES_PER_BOOT      1000u
+#define RECORD_LEN          32u
+    // Rated erase cycles of a flash row
+#define ROW_ENDURANCE       25000u
+
+static uint32_t rng_state;
+static uint32_t rng_next(uint32_t bound){
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state % bound;
+}
+
+static void make_record(uint8_t* dest, uint32_t n){
+    uint32_t k = 0;
+    for(; k < RECORD_LEN; ++k)  dest[k] = (uint8_t)(n * 131u + k * 7u);
+}
+
+static void power_up(void){
+    sim_rewind();
+    persist_init();
+}
+
+static void run_wear(uint32_t saves){
+    uint8_t record[RECORD_LEN];
+    uint32_t n = 0, row = 0, low = UINT32_MAX, high = 0, total = 0;
+    sim_nvm_reset();
+    power_up();
+    for(; n < saves; ++n){
+        if(n && n % SAVES_PER_BOOT == 0u)   power_up();
+        make_record(record, n);
+        persist_save(record, RECORD_LEN);
+    }
+    for(; row < HAL_NVM_ROWS; ++row){
+        if(sim_nvm_erases[row] < low)   low = sim_nvm_erases[row];
+        if(sim_nvm_erases[row] > high)  high = sim_nvm_erases[row];
+        total += sim_nvm_erases[row];
+    }
+    printf(
+        "wear      %u saves, %u erases (%.3f per save), per row %u - %u\n"
+        "          saves to rated wear: %llu, in place %u\n",
+        saves, total, saves ? (double)total / saves : 0.0, low, high,
+        (unsigned long long)ROW_ENDURANCE * HAL_NVM_SIZE / HAL_NVM_PAGE_SIZE,
+        ROW_ENDURANCE
+    );
+}
+
+static void run_cuts(uint32_t cuts){
+    uint8_t record[RECORD_LEN], back[RECORD_LEN];
+    uint32_t n = 0, saved = 0, lost = 0, stale = 0, stuck = 0;
+    rng_state = BENCH_SEED;
+    sim_nvm_reset();
+    power_up();
+    for(; n < cuts; ++n){
+            // A few saves that go through, then one that does not
+        uint32_t k = 1u + rng_next(8u);
+        for(; k > 0u; --k){
+            make_record(record, ++saved);
+            persist_save(record, RECORD_LEN);
+        }
+        make_record(record, saved + 1u);
+        sim_nvm_cut(rng_next(HAL_NVM_ROW_SIZE));
+        persist_save(record, RECORD_LEN);
+
+        power_up();
+        make_record(record, saved);
+        if(!persist_load(back, RECORD_LEN)){
+            ++lost;
+        } else if(memcmp(back, record, RECORD_LEN) != 0){
+                // The cut save may have made it, if the cut came after
+                //  the last byte that mattered
+            make_record(record, saved + 1u);
+            if(memcmp(back, record, RECORD_LEN) == 0)   ++saved;
+            else                                        ++stale;
+        }
+
+        make_record(record, ++saved);
+        persist_save(record, RECORD_LEN);
+        power_up();
+        if(!persist_load(back, RECORD_LEN) || memcmp(back, record, RECORD_LEN))
+            ++stuck;
+    }
+    printf(
+        "cuts      %u power losses: %u lost, %u stale, %u stuck after\n"
+        "          start up reads %u bytes\n",
+        cuts, lost, stale, stuck, HAL_NVM_SIZE
+    );
+}
+
+    // What the display shows before the first key goes down
+static char shown[16];
+static uint64_t first_key;
+static void catch_display(void){
+    if(sim_cycles < first_key)  sim_render(shown, sizeof(shown));
+}
+
+static void run_firmware(void){
+    static const char keys[] = "12+34EQ";
+    uint64_t at = first_key = US_TO_CYCLES(2000000u);
+    const char* key = keys;
+    sim_nvm_reset();
+    for(; *key; ++key){
+        sim_inject(at, sim_key_bits(*key), 1);
+        at += US_TO_CYCLES(80000u);
+        sim_inject(at, sim_key_bits(*key), 0);
+        at += US_TO_CYCLES(220000u);
+    }
+
+        // The first run is turned off with the result on show. The second
+        //  replays the same keys; what it shows before them is what it
+        //  came back with.
+    sim_rewind();
+    firmware_main();
+    sim_rewind();
+    shown[0] = '\0';
+    sim_display_hook = catch_display;
+    firmware_main();
+    sim_display_hook = NULL;
+    printf("%-9s [%s]\n", "restored", shown);
+}
+
+int main(int argc, char* argv[]){
+    uint32_t saves = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 0u;
+    uint32_t cuts = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 0u;
+    if(saves == 0u) saves = BENCH_SAVES;
+    if(cuts == 0u)  cuts = BENCH_CUTS;
+
+    run_wear(saves);
+    run_cuts(cuts);
+    run_firmware();
+    return 0;
+}
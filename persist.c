@@ -0,0 +1,114 @@
+#include "persist.h"
+#include "hal.h"
+
+#define SLOTS           (HAL_NVM_SIZE / HAL_NVM_PAGE_SIZE)
+#define RECORD_TAG      0xA5u
+    // Erased flash reads as all ones, so no record has this number
+#define SEQ_ERASED      0xFFFFFFFFu
+
+    // One record fills one page
+union record{
+    struct{
+        uint32_t seq;
+        uint16_t crc;
+        uint8_t  len, tag;
+        uint8_t  data[PERSIST_MAX];
+    } f;
+    uint32_t words[HAL_NVM_PAGE_SIZE / 4u];
+};
+
+static HAL_UNIT union record newest;
+static HAL_UNIT uint8_t have_newest;
+static HAL_UNIT uint32_t next_slot;
+
+static uint16_t crc_byte(uint16_t crc, uint8_t byte){
+    uint8_t bit = 0u;
+    crc ^= (uint16_t)byte << 8;
+    for(; bit < 8u; ++bit)
+        crc = crc & 0x8000u ? (uint16_t)((crc << 1) ^ 0x1021u) : crc << 1;
+    return crc;
+}
+
+    // CRC-16/CCITT over the sequence number, the length and the data
+static uint16_t record_crc(const union record* rec){
+    uint16_t crc = 0xFFFFu;
+    uint32_t n = 0u;
+    for(; n < 4u; ++n)  crc = crc_byte(crc, (uint8_t)(rec->f.seq >> (8u * n)));
+    crc = crc_byte(crc, rec->f.len);
+    for(n = 0u; n < rec->f.len; ++n)    crc = crc_byte(crc, rec->f.data[n]);
+    return crc;
+}
+
+static uint8_t record_valid(const union record* rec){
+    return rec->f.tag == RECORD_TAG && rec->f.seq != SEQ_ERASED
+        && rec->f.len <= PERSIST_MAX && rec->f.crc == record_crc(rec);
+}
+
+static uint8_t slot_blank(uint32_t slot){
+    union record rec;
+    uint32_t n = 0u;
+    hal_nvm_read(slot * HAL_NVM_PAGE_SIZE, (uint8_t*)&rec, sizeof(rec));
+    for(; n < HAL_NVM_PAGE_SIZE / 4u; ++n)
+        if(rec.words[n] != 0xFFFFFFFFu) return 0u;
+    return 1u;
+}
+
+void persist_init(void){
+    union record rec;
+    uint32_t slot = 0u;
+    have_newest = 0u;
+    next_slot = 0u;
+    for(; slot < SLOTS; ++slot){
+        hal_nvm_read(slot * HAL_NVM_PAGE_SIZE, (uint8_t*)&rec, sizeof(rec));
+        if(!record_valid(&rec))  continue;
+            // Sequence numbers are compared across wrap-around
+        if(have_newest && (int32_t)(rec.f.seq - newest.f.seq) <= 0)
+            continue;
+        newest = rec;
+        have_newest = 1u;
+        next_slot = (slot + 1u) % SLOTS;
+    }
+}
+
+uint8_t persist_load(void* dest, uint32_t len){
+    uint8_t* out = dest;
+    uint32_t n = 0u;
+    if(!have_newest || newest.f.len != len) return 0u;
+    for(; n < len; ++n) out[n] = newest.f.data[n];
+    return 1u;
+}
+
+uint8_t persist_save(const void* src, uint32_t len){
+    const uint8_t* in = src;
+    union record rec;
+    uint32_t n = 0u, slot = next_slot;
+    if(len > PERSIST_MAX)   return 0u;
+    if(have_newest && newest.f.len == len){
+        for(; n < len && newest.f.data[n] == in[n]; ++n);
+        if(n == len)    return 1u;
+    }
+
+    for(n = 0u; n < HAL_NVM_PAGE_SIZE / 4u; ++n)    rec.words[n] = SEQ_ERASED;
+    rec.f.seq = have_newest ? newest.f.seq + 1u : 0u;
+    if(rec.f.seq == SEQ_ERASED) rec.f.seq = 0u;
+    rec.f.len = (uint8_t)len;
+    rec.f.tag = RECORD_TAG;
+    for(n = 0u; n < len; ++n)   rec.f.data[n] = in[n];
+    rec.f.crc = record_crc(&rec);
+
+        // A row is erased on the way in. Pages further on in a row are
+        //  still blank, unless a save was cut short there; step past
+        //  those, at most once round the region.
+    for(n = 0u; n < SLOTS; ++n, slot = (slot + 1u) % SLOTS){
+        if(slot % HAL_NVM_ROW_PAGES == 0u){
+            hal_nvm_erase_row(slot * HAL_NVM_PAGE_SIZE);
+            break;
+        }
+        if(slot_blank(slot))    break;
+    }
+    hal_nvm_write_page(slot * HAL_NVM_PAGE_SIZE, rec.words);
+    newest = rec;
+    have_newest = 1u;
+    next_slot = (slot + 1u) % SLOTS;
+    return 1u;
+}
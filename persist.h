@@ -0,0 +1,31 @@
+#ifndef PERSIST_H
+#define PERSIST_H
+
+    // Log-structured record store in the flash region of hal.h. A save
+    //  appends one record to the next free page, and the rows are reused
+    //  in turn, so a row is erased once every HAL_NVM_ROW_PAGES saves and
+    //  the wear is spread evenly over the region, whatever gets saved.
+    //  The row erased is always the oldest, so the newest record survives
+    //  a power loss at any point.
+    //
+    // Each record carries a sequence number and a CRC. At start up the
+    //  newest record that checks out is found by reading every page once,
+    //  a fixed HAL_NVM_SIZE bytes, whatever the state of the flash; a save
+    //  cut short leaves a record that fails its check, and the one before
+    //  it wins.
+
+#include <stdint.h>
+
+    // Largest record: one page of HAL_NVM_PAGE_SIZE less the header
+#define PERSIST_MAX     56u
+
+    // Find the newest record. Call once after hal_init().
+void persist_init(void);
+    // Copy the newest record to dest. Returns 0 when there is none or it
+    //  is not len bytes long.
+uint8_t persist_load(void* dest, uint32_t len);
+    // Append a record, unless the newest already holds the same bytes.
+    //  Returns 0 when len is over PERSIST_MAX.
+uint8_t persist_save(const void* src, uint32_t len);
+
+#endif
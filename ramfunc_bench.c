@@ -0,0 +1,114 @@
+    // Cost of the keypad scan and display refresh loop run from flash and
+    //  from RAM, on both CPU clocks, run on the host simulator.
+    //
+    //  Build:  cc -DHOST_SIM -O2 -o ramfunc_bench
+    //              ramfunc_bench.c host_sim.c main.c sched.c serial.c
+    //              clock.c persist.c trace.c
+    //  Usage:  ramfunc_bench [ms]
+    //
+    // The firmware is brought up as run_calculator() does, with only the
+    //  I/O tasks started, and the scheduler is stepped for a while with no
+    //  key down: every millisecond scan_task() and display_task() run and
+    //  the CPU sleeps until the next tick. This is the loop RAM_HOT in
+    //  hal.h moves to RAM.
+    //
+    // The simulator cannot tell which code is in RAM, so "ram" runs the
+    //  same build with sim_code_in_ram set for the whole loop, scheduler
+    //  included, which RAM_HOT leaves in flash; the gain shown is an upper
+    //  bound. Flash wait states only come in above SIM_FLASH_0WS_HZ, so at
+    //  1 MHz both placements cost the same.
+    //
+    // Reported per clock and placement:
+    //  - CPU cycles awake per millisecond pass, and that time in us
+    //  - MCU energy per second, from the energy model of host_sim.h
+
+#include "hal.h"
+#include "clock.h"
+#include "sched.h"
+
+#include <stdlib.h>
+
+#define BENCH_MS            10000u
+    // Let the first passes settle before counting
+#define SETTLE_MS           100u
+
+    // From main.c
+void configure_ports(void);
+void configure_tasks(void);
+void set_initial_state(void);
+void start_io_tasks(void);
+
+struct profile{
+    const char* name;
+    uint8_t policy;
+};
+
+struct placement{
+    const char* name;
+    uint8_t in_ram;
+};
+
+static const struct profile profiles[] = {
+    {"1M",      CLOCK_POLICY_IDLE},
+    {"48M",     CLOCK_POLICY_BURST},
+};
+
+static const struct placement placements[] = {
+    {"flash",   0u},
+    {"ram",     1u},
+};
+
+    // Step the scheduler until ms have passed on its clock
+static void run_for(uint32_t ms){
+    uint32_t until = sched_now() + ms;
+    while((int32_t)(sched_now() - until) < 0)   sched_step();
+}
+
+static void run_profile(
+    const struct profile* p, const struct placement* where, uint32_t ms
+){
+    sim_rewind();
+    sim_code_in_ram = where->in_ram;
+    clock_policy(p->policy);
+    configure_ports();
+    configure_tasks();
+    set_initial_state();
+    start_io_tasks();
+    run_for(SETTLE_MS);
+
+    uint64_t cpu = sim_cpu_cycles, asleep = sim_sleep_cycles;
+    uint64_t cycles = sim_cycles;
+    double mcu = sim_energy.mcu;
+    run_for(ms);
+    cycles = sim_cycles - cycles;
+    asleep = sim_sleep_cycles - asleep;
+        // The clock is fixed for the run, so sleep is in the same ratio
+    cpu = sim_cpu_cycles - cpu - asleep * (sim_cpu_hz / SIM_CPU_HZ);
+    mcu = sim_energy.mcu - mcu;
+
+    printf(
+        "%-4s %-6s %9.1f %8.2f %10.2f\n",
+        p->name, where->name,
+        (double)cpu / ms,
+        (double)(cycles - asleep) * 1000000.0 / SIM_CPU_HZ / ms,
+        mcu * 1000.0 / ms
+    );
+    sim_code_in_ram = 0u;
+}
+
+int main(int argc, char* argv[]){
+    uint32_t ms = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 0u;
+    size_t p = 0, w = 0;
+    if(ms == 0u)    ms = BENCH_MS;
+
+    printf(
+        "%-4s %-6s %9s %8s %10s\n",
+        "cpu", "code", "cyc/pass", "us/pass", "mcu_uJ/s"
+    );
+    for(; p < sizeof(profiles) / sizeof(profiles[0]); ++p){
+        for(w = 0; w < sizeof(placements) / sizeof(placements[0]); ++w)
+            run_profile(&profiles[p], &placements[w], ms);
+    }
+    clock_policy(CLOCK_POLICY_SWITCH);
+    return 0;
+}
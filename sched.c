@@ -0,0 +1,214 @@
+#include "sched.h"
+#include "clock.h"
+#include "hal.h"
+
+#include <string.h>
+
+struct sched_task{
+    const char* name;
+    sched_fn run;
+    uint32_t period, deadline;
+        // Next release in ms. Only meaningful while armed.
+    uint32_t due;
+        // hal_cycles() when posted, for the jitter of event releases
+    uint32_t posted_at;
+    uint8_t started, armed, posted;
+    struct sched_stats stats;
+};
+
+static HAL_UNIT struct sched_task tasks[SCHED_MAX_TASKS];
+static HAL_UNIT uint8_t task_count;
+static HAL_UNIT uint8_t exiting;
+static HAL_UNIT uint32_t passes;
+
+HAL_UNIT volatile uint32_t sched_ms;
+    // hal_cycles() at the last tick, and how many ms the tick in progress
+    //  stands for
+static HAL_UNIT volatile uint32_t tick_stamp;
+static HAL_UNIT volatile uint32_t tick_span = 1u;
+
+void HAL_TICK_HANDLER(void){
+    hal_tick_ack();
+    tick_stamp = hal_cycles();
+    sched_ms += tick_span;
+    if(tick_span != 1u){
+        tick_span = 1u;
+        hal_tick_stretch(1u);
+    }
+}
+
+uint32_t sched_now_us(void){
+    uint32_t ms = 0u, count = 0u;
+        // A tick between the two reads starts the count over
+    do{
+        ms = sched_ms;
+        count = hal_tick_count();
+    } while(ms != sched_ms);
+    return ms * 1000u + count * 1000u / HAL_TIMER_PER_TICK;
+}
+
+uint8_t sched_expired(uint32_t deadline){
+    return (int32_t)(sched_ms - deadline) >= 0;
+}
+
+uint8_t sched_expired_us(uint32_t deadline){
+    return (int32_t)(sched_now_us() - deadline) >= 0;
+}
+
+void sched_reset(void){
+    memset(tasks, 0, sizeof(tasks));
+    task_count = 0u;
+    exiting = 0u;
+}
+
+uint8_t sched_add(
+    const char* name, sched_fn run, uint32_t period, uint32_t deadline
+){
+    struct sched_task* t = NULL;
+    if(task_count == SCHED_MAX_TASKS)   return SCHED_MAX_TASKS;
+    t = &tasks[task_count];
+    memset(t, 0, sizeof(*t));
+    t->name = name;
+    t->run = run;
+    t->period = period;
+    t->deadline = deadline;
+    return task_count++;
+}
+
+void sched_start(uint8_t id, uint32_t delay){
+    tasks[id].started = tasks[id].armed = 1u;
+    tasks[id].posted = 0u;
+    tasks[id].due = sched_ms + delay;
+}
+
+void sched_stop(uint8_t id){
+    tasks[id].started = tasks[id].armed = 0u;
+}
+
+void sched_post(uint8_t id){
+    if(!tasks[id].started || (tasks[id].armed && tasks[id].posted))  return;
+    tasks[id].armed = tasks[id].posted = 1u;
+    tasks[id].due = sched_ms;
+    tasks[id].posted_at = hal_cycles();
+}
+
+static void run_task(struct sched_task* t, uint32_t now){
+    uint32_t start = hal_cycles(), jitter = 0u, release = t->due;
+    if(t->posted){
+        jitter = (start - t->posted_at) & HAL_CYCLES_MASK;
+    } else {
+        jitter = (now - release) * (clock_hz() / TICK_HZ)
+            + ((start - tick_stamp) & HAL_CYCLES_MASK);
+    }
+    t->posted = 0u;
+
+    if(t->period){
+        t->due += t->period;
+        while((int32_t)(now - t->due) >= 0){
+            t->due += t->period;
+            ++t->stats.skipped;
+        }
+    } else {
+        t->armed = 0u;
+    }
+
+    t->run();
+
+    uint32_t ran = (hal_cycles() - start) & HAL_CYCLES_MASK;
+    ++t->stats.runs;
+    if(jitter > t->stats.max_jitter)    t->stats.max_jitter = jitter;
+    if(ran > t->stats.max_run)          t->stats.max_run = ran;
+    if((int32_t)(sched_ms - release) > (int32_t)t->deadline)
+        ++t->stats.overruns;
+}
+
+    // Sleep until the next tick, or the tick after wait ms when there is
+    //  nothing to do before then.
+static void idle(uint32_t wait){
+    hal_irq_off();
+        // A tick that is already pending must be counted as one ms
+    if(wait > 1u && tick_span == 1u && !hal_tick_pending()){
+        if(wait > HAL_TICK_STRETCH_MAX) wait = HAL_TICK_STRETCH_MAX;
+        tick_span = wait;
+        hal_tick_stretch(wait);
+            // The tick came while CC0 was synchronizing. It still stands
+            //  for one ms, and so must the one after it.
+        if(hal_tick_pending()){
+            hal_tick_stretch(1u);
+            tick_span = 1u;
+        }
+    }
+    hal_sleep();
+    hal_irq_on();
+}
+
+uint8_t sched_step(void){
+    uint32_t now = sched_ms, wait = HAL_TICK_STRETCH_MAX;
+    uint8_t n = 0u, ran = 0u;
+    ++passes;
+    for(; n < task_count && !exiting; ++n){
+        if(!tasks[n].armed || (int32_t)(now - tasks[n].due) < 0)    continue;
+        run_task(&tasks[n], now);
+        ++ran;
+    }
+    if(ran || exiting)  return ran;
+
+        // Tasks only post each other while running, so nothing can become
+        //  due before the earliest armed release.
+    for(n = 0u; n < task_count; ++n){
+        if(tasks[n].armed && tasks[n].due - now < wait)
+            wait = tasks[n].due - now;
+    }
+    idle(wait);
+    return 0u;
+}
+
+void sched_run(void){
+    exiting = 0u;
+    while(!exiting && HAL_RUNNING())    sched_step();
+    exiting = 0u;
+}
+
+void sched_exit(void){
+    exiting = 1u;
+}
+
+void sched_sleep(uint32_t ms){
+    uint32_t until = sched_ms + ms;
+    while(!sched_expired(until) && HAL_RUNNING())
+        idle(until - sched_ms);
+}
+
+void sched_sleep_us(uint32_t us){
+    uint32_t until = sched_now_us() + us;
+    int32_t left = (int32_t)us;
+        // The tick in progress began before now, so sleeping left/1000
+        //  ticks from its start never passes the deadline
+    while(left > 1000 && HAL_RUNNING()){
+        idle((uint32_t)left / 1000u);
+        left = (int32_t)(until - sched_now_us());
+    }
+    while(!sched_expired_us(until) && HAL_RUNNING());
+}
+
+uint32_t sched_passes(void){
+    return passes;
+}
+
+uint8_t sched_count(void){
+    return task_count;
+}
+
+const char* sched_name(uint8_t id){
+    return tasks[id].name;
+}
+
+const struct sched_stats* sched_stats(uint8_t id){
+    return &tasks[id].stats;
+}
+
+void sched_clear_stats(void){
+    uint8_t n = 0u;
+    for(; n < task_count; ++n)
+        memset(&tasks[n].stats, 0, sizeof(tasks[n].stats));
+}
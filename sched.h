@@ -0,0 +1,94 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+    // Cooperative scheduler on the refresh timer. Tasks run to completion
+    //  in the order they were added, so an earlier task always goes first
+    //  when several are due in the same millisecond.
+    //
+    //  - A periodic task is released every period ms once started.
+    //  - A task with period 0 runs once per sched_start(), after the given
+    //    delay; sched_post() is the same with no delay.
+    //
+    // Each task has a deadline in ms after its release. Finishing in a
+    //  later millisecond than release + deadline counts as an overrun.
+    //
+    // When nothing is due, the scheduler sleeps until the next release,
+    //  stretching the timer period so that it is not woken every tick on
+    //  the way (tickless idle).
+    //
+    // The same timer is the time base for deadlines and waits, in ms and
+    //  in us. It runs off a clock of its own, so neither depends on the
+    //  CPU clock or on how long the code between two checks takes. Rather
+    //  than waiting, code that has other work keeps a deadline and checks
+    //  sched_expired() each time it comes round.
+
+#include "hal.h"
+
+#include <stdint.h>
+
+#define SCHED_MAX_TASKS     8u
+
+typedef void (*sched_fn)(void);
+
+struct sched_stats{
+    uint32_t runs;
+        // Finished after the deadline
+    uint32_t overruns;
+        // Periodic releases dropped because the task was still waiting
+        //  for an earlier one
+    uint32_t skipped;
+        // Longest time from release to start, and longest run, in CPU
+        //  cycles. A task that raises the clock (see clock.h) counts its
+        //  run at the faster rate.
+    uint32_t max_jitter;
+    uint32_t max_run;
+};
+
+    // Milliseconds since the timer started. Wraps after 49 days, so compare
+    //  times by the sign of their difference. Counted by the tick
+    //  interrupt and read inline, so that a time stamp is one load.
+extern HAL_UNIT volatile uint32_t sched_ms;
+static inline uint32_t sched_now(void){
+    return sched_ms;
+}
+    // Microseconds since the timer started, read from the running count.
+    //  Wraps after 71 minutes.
+uint32_t sched_now_us(void);
+    // Whether a deadline taken from sched_now() or sched_now_us() has
+    //  come. Deadlines up to half the wrap ahead are told apart.
+uint8_t sched_expired(uint32_t deadline);
+uint8_t sched_expired_us(uint32_t deadline);
+
+    // Drop every task.
+void sched_reset(void);
+    // Add a stopped task and return its id, or SCHED_MAX_TASKS when the
+    //  table is full.
+uint8_t sched_add(
+    const char* name, sched_fn run, uint32_t period, uint32_t deadline
+);
+void sched_start(uint8_t id, uint32_t delay);
+void sched_stop(uint8_t id);
+    // Release a started task now. Posts to a stopped task are ignored.
+void sched_post(uint8_t id);
+
+    // Run every task that is due, in order, or sleep until the next
+    //  release if none is. Returns the number of tasks run.
+uint8_t sched_step(void);
+    // Step until sched_exit() is called.
+void sched_run(void);
+void sched_exit(void);
+    // Sleep for ms without running any task.
+void sched_sleep(uint32_t ms);
+    // Wait us without running any task, asleep through whole ticks and
+    //  polling the timer for the rest.
+void sched_sleep_us(uint32_t us);
+
+    // Passes through sched_step() since start up, wrapping
+uint32_t sched_passes(void);
+
+uint8_t sched_count(void);
+const char* sched_name(uint8_t id);
+const struct sched_stats* sched_stats(uint8_t id);
+void sched_clear_stats(void);
+
+#endif
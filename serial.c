@@ -0,0 +1,64 @@
+#include "serial.h"
+#include "hal.h"
+
+    // Each ring has one writer and one reader, one of them the interrupt
+    //  handler, and each index is only stored by its own side.
+static HAL_UNIT volatile uint8_t rx_buf[SERIAL_RX_LEN];
+static HAL_UNIT volatile uint32_t rx_head, rx_tail;
+static HAL_UNIT volatile uint8_t tx_buf[SERIAL_TX_LEN];
+static HAL_UNIT volatile uint32_t tx_head, tx_tail;
+static HAL_UNIT volatile uint32_t rx_dropped;
+
+void HAL_UART_HANDLER(void){
+    while(hal_uart_rx_ready()){
+        uint8_t byte = hal_uart_get();
+        uint32_t next = (rx_head + 1u) & (SERIAL_RX_LEN - 1u);
+        if(next == rx_tail){
+            ++rx_dropped;
+            continue;
+        }
+        rx_buf[rx_head] = byte;
+        rx_head = next;
+    }
+    while(tx_tail != tx_head && hal_uart_tx_ready()){
+        hal_uart_put(tx_buf[tx_tail]);
+        tx_tail = (tx_tail + 1u) & (SERIAL_TX_LEN - 1u);
+    }
+        // Nothing left to send; serial_write() turns this back on
+    if(tx_tail == tx_head)  hal_uart_tx_irq(0u);
+}
+
+void serial_init(void){
+    rx_head = rx_tail = tx_head = tx_tail = 0u;
+    rx_dropped = 0u;
+    hal_uart_init();
+}
+
+uint8_t serial_read(uint8_t* byte){
+    uint32_t tail = rx_tail;
+    if(tail == rx_head) return 0u;
+    *byte = rx_buf[tail];
+    rx_tail = (tail + 1u) & (SERIAL_RX_LEN - 1u);
+    return 1u;
+}
+
+uint32_t serial_space(void){
+    return (tx_tail - tx_head - 1u) & (SERIAL_TX_LEN - 1u);
+}
+
+uint8_t serial_write(const char* text, uint32_t len){
+    uint32_t head = tx_head;
+    if(len > serial_space())    return 0u;
+    for(; len > 0u; --len, ++text){
+        tx_buf[head] = (uint8_t)*text;
+        head = (head + 1u) & (SERIAL_TX_LEN - 1u);
+    }
+        // Publish the bytes before the handler can look for them
+    tx_head = head;
+    hal_uart_tx_irq(1u);
+    return 1u;
+}
+
+uint32_t serial_dropped(void){
+    return rx_dropped;
+}
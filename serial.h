@@ -0,0 +1,27 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+    // Interrupt driven transport for the serial port. The UART interrupt
+    //  moves received bytes into one ring and feeds the transmitter from
+    //  another, so neither side ever waits on the line and the display
+    //  multiplex keeps its timing. Bytes that arrive while the receive
+    //  ring is full are dropped and counted.
+
+#include <stdint.h>
+
+    // Ring sizes, powers of two. A ring holds one byte less than its size.
+#define SERIAL_RX_LEN       64u
+#define SERIAL_TX_LEN       256u
+
+void serial_init(void);
+    // Take the next received byte. Returns 0 when there is none.
+uint8_t serial_read(uint8_t* byte);
+    // Bytes that serial_write() can take right now
+uint32_t serial_space(void);
+    // Queue len bytes for sending, all of them or, when they do not fit,
+    //  none. Returns 0 in the latter case.
+uint8_t serial_write(const char* text, uint32_t len);
+    // Received bytes dropped on a full ring since start up
+uint32_t serial_dropped(void);
+
+#endif
@@ -0,0 +1,116 @@
+    // Run the calculator firmware on the host against a scripted keypad.
+    //
+    //  Build:  cc -DHOST_SIM -o sim
+    //              sim.c host_sim.c main.c sched.c serial.c
+    //              clock.c persist.c trace.c
+    //  Usage:  sim [-u link] [trace_file]  (reads stdin without either)
+    //
+    // The trace holds "<time_us> <key> <1|0>" lines; see sim_load_trace()
+    //  in host_sim.h for the key names. Every change of the visible
+    //  display is printed with its virtual time in milliseconds, and the
+    //  scheduler's per-task statistics and the energy used (see
+    //  sim_energy_report() in host_sim.h) go to stderr at the end.
+    //
+    // With -u the serial port is bound to a pseudo-terminal, and link is
+    //  made a symbolic link to it for test scripts to open. The commands
+    //  are listed with serial_task() in main.c. For example:
+    //
+    //      sim -u /tmp/calc > shown.log &
+    //      sleep 1; exec 3<>/tmp/calc
+    //      printf 'k 12+34E\nd\n' >&3
+    //      read -r k <&3; read -r d <&3; echo "$d"     --> d [ 46.  ]
+    //
+    //  The run ends once the script closes the port.
+    //
+    // Built with -DEVENT_TRACE as well, the event trace of trace.h is
+    //  decoded to stderr at the end, as far back as the ring goes.
+
+#include "host_sim.h"
+#include "sched.h"
+#include "trace.h"
+
+#include <string.h>
+#include <unistd.h>
+
+static void print_display(void){
+    char text[16];
+    sim_render(text, sizeof(text));
+    printf("%12.3f  [%s]\n", sim_cycles * 1000.0 / SIM_CPU_HZ, text);
+}
+
+static void print_trace(void){
+    static const char* const kinds[TRACE_KINDS] = {
+        "?", "key", "input", "dig", "op", "del", "compute", "sigma"
+    };
+    struct trace_rec rec;
+    uint32_t seq = 0;
+    while(trace_read(&rec, &seq)){
+        fprintf(stderr,
+            "%8lu %6u  %-8s %3u %10lu  0x%08lx\n",
+            (unsigned long)seq, rec.at,
+            kinds[rec.kind < TRACE_KINDS ? rec.kind : 0], rec.arg,
+            (unsigned long)rec.value, (unsigned long)rec.value
+        );
+    }
+}
+
+int main(int argc, char* argv[]){
+    FILE* src = stdin;
+    const char* link = NULL;
+    int arg = 1;
+    if(arg + 1 < argc && strcmp(argv[arg], "-u") == 0){
+        link = argv[arg + 1];
+        arg += 2;
+    }
+    if(arg < argc){
+        src = fopen(argv[arg], "r");
+        if(src == NULL){
+            fprintf(stderr, "Usage: %s [-u link] [trace_file]\n", argv[0]);
+            return 1;
+        }
+    }
+
+        // Driven over the serial port alone, there is no trace to read
+    long loaded = link && src == stdin ? 0 : sim_load_trace(src);
+    if(src != stdin)    fclose(src);
+    if(loaded < 0){
+        fprintf(stderr, "%s: malformed trace line\n", argv[0]);
+        return 1;
+    }
+
+    if(link){
+        const char* port = sim_uart_open();
+        unlink(link);
+        if(port == NULL || symlink(port, link) != 0){
+            perror(link);
+            return 1;
+        }
+        fprintf(stderr, "%s: serial port %s at %s\n", argv[0], port, link);
+    }
+
+    sim_display_hook = print_display;
+    firmware_main();
+    if(link){
+        sim_uart_close();
+        unlink(link);
+    }
+
+    uint8_t id = 0;
+    fprintf(stderr,
+        "%-8s %8s %8s %8s %12s %12s\n",
+        "task", "runs", "overrun", "skipped", "jitter(cyc)", "run(cyc)"
+    );
+    for(; id < sched_count(); ++id){
+        const struct sched_stats* st = sched_stats(id);
+        fprintf(stderr,
+            "%-8s %8lu %8lu %8lu %12lu %12lu\n", sched_name(id),
+            (unsigned long)st->runs, (unsigned long)st->overruns,
+            (unsigned long)st->skipped, (unsigned long)st->max_jitter,
+            (unsigned long)st->max_run
+        );
+    }
+    sim_energy_report(stderr);
+    print_trace();
+
+    return 0;
+}
@@ -0,0 +1,17 @@
+#include "trace.h"
+
+#ifdef EVENT_TRACE
+HAL_UNIT struct trace_rec trace_ring[TRACE_LEN];
+HAL_UNIT uint32_t trace_written;
+    // Records read since start up
+static HAL_UNIT uint32_t read;
+
+uint8_t trace_read(struct trace_rec* dest, uint32_t* seq){
+        // Lapped; the oldest left is a ring behind
+    if(trace_written - read > TRACE_LEN)  read = trace_written - TRACE_LEN;
+    if(read == trace_written)   return 0u;
+    *seq = read;
+    *dest = trace_ring[read++ & (TRACE_LEN - 1u)];
+    return 1u;
+}
+#endif
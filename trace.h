@@ -0,0 +1,72 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+    // Event trace in RAM, for finding out afterwards what a unit that
+    //  misbehaved was doing. TRACE() stores one record of a kind, an 8 bit
+    //  argument and a 32 bit value, stamped with sched_now(), in a ring of
+    //  the last TRACE_LEN records; older ones are written over. A record
+    //  is a handful of stores, with no check and no wait, and it is only
+    //  ever put from tasks, never from an interrupt.
+    //
+    // The trace is built in with EVENT_TRACE on the compiler command line.
+    //  Without it TRACE() is nothing, the ring takes no RAM and
+    //  trace_read() never has a record.
+
+#include <stdint.h>
+
+    // Records kept. A power of two.
+#ifndef TRACE_LEN
+#define TRACE_LEN       64u
+#endif
+
+    // Kinds, and what main.c puts in arg and value
+#define TRACE_KEY       1u  // Key scanned: row, column bits
+#define TRACE_INPUT     2u  // Press decoded: INPUT_TYPE, button
+#define TRACE_DIG       3u  // Digit stored: state, index << 8 | digit
+#define TRACE_OP        4u  // Operator stored: state, index << 8 | glyph
+#define TRACE_DEL       5u  // Entry deleted: state, index
+#define TRACE_COMPUTE   6u  // Enter computed: error, result (low 32 bits)
+#define TRACE_SIGMA     7u  // Statistics key: SIGMA_ADD/NEXT/CLEAR, count
+#define TRACE_KINDS     8u
+
+struct trace_rec{
+        // sched_now(), low 16 bits
+    uint16_t at;
+    uint8_t  kind, arg;
+    uint32_t value;
+};
+
+#ifdef EVENT_TRACE
+#include "hal.h"
+#include "sched.h"
+
+    // The ring, and records put since start up. Put inline, so that a
+    //  traced site costs the stores and no call.
+extern HAL_UNIT struct trace_rec trace_ring[TRACE_LEN];
+extern HAL_UNIT uint32_t trace_written;
+
+static inline void trace_put(uint8_t kind, uint8_t arg, uint32_t value){
+    struct trace_rec* rec = &trace_ring[trace_written++ & (TRACE_LEN - 1u)];
+    rec->at = (uint16_t)sched_now();
+    rec->kind = kind;
+    rec->arg = arg;
+    rec->value = value;
+}
+    // Take the oldest record not read yet. seq is its number, counting
+    //  every record put since start up, so a gap shows records that were
+    //  written over before they were read. Returns 0 when there is none.
+uint8_t trace_read(struct trace_rec* dest, uint32_t* seq);
+
+#define TRACE(KIND, ARG, VALUE) \
+    trace_put((KIND), (uint8_t)(ARG), (uint32_t)(VALUE))
+#else
+static inline uint8_t trace_read(struct trace_rec* dest, uint32_t* seq){
+    (void)dest;
+    (void)seq;
+    return 0u;
+}
+
+#define TRACE(KIND, ARG, VALUE) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,187 @@
+    // Throughput of the batch kernels in vec_eval.c against looping the
+    //  firmware's own compute(), on the host.
+    //
+    //  Build:  cc -DHOST_SIM -O2 -o vec_bench
+    //              vec_bench.c vec_eval.c host_sim.c main.c sched.c serial.c
+    //              clock.c persist.c trace.c
+    //  Usage:  vec_bench [count]
+    //
+    // For each radix, count random expressions (operands of zero to four
+    //  digits, random signs and operators) are evaluated by compute() one
+    //  at a time and by each kernel the CPU supports. Every kernel result is
+    //  checked against compute(): overload, sign and every digit.
+
+#include "hal.h"
+#include "vec_eval.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_COUNT     (1u << 20)
+#define BENCH_SEED      0x9E3779B9u
+#define BENCH_REPS      3u
+
+    // From main.c
+uint8_t compute_exp(
+    const uint8_t* operand, uint8_t is_neg, uint8_t op_code, uint8_t radix_sel
+);
+uint8_t result_digits(const uint8_t** digits, uint8_t* neg);
+
+    // Radices in the order of radix_cycle in main.c
+static const uint8_t radices[] = {10u, 16u, 8u, 2u};
+static const uint8_t ops[] = {
+    VEC_ADD, VEC_SUB, VEC_MUL, VEC_DIV,
+    VEC_AND, VEC_OR, VEC_XOR, VEC_SHL, VEC_SHR
+};
+
+static uint32_t rng_state;
+static uint32_t rng_next(uint32_t bound){
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state % bound;
+}
+
+static double now_s(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void make_exprs(
+    uint8_t* operand, uint8_t* is_neg, uint8_t* op_code, size_t count,
+    uint8_t radix
+){
+    size_t k = 0;
+    for(; k < count; ++k){
+        uint8_t* digits = operand + k * VEC_OPERAND_DIGITS * 2u;
+        uint8_t side = 0, n = 0, len = 0;
+        for(; side < 2u; ++side, digits += VEC_OPERAND_DIGITS){
+            len = rng_next(VEC_OPERAND_DIGITS + 1u);
+            for(n = 0; n < VEC_OPERAND_DIGITS; ++n){
+                    // No leading zeros, as store_dig() would have it
+                digits[n] = n >= len ? VEC_NULL_DIG
+                    : n ? rng_next(radix) : 1u + rng_next(radix - 1u);
+            }
+        }
+        is_neg[k] = rng_next(4u);
+        op_code[k] = ops[rng_next(sizeof(ops))];
+    }
+}
+
+    // Best of BENCH_REPS runs of compute() over the batch, in seconds
+static double time_compute(
+    const uint8_t* operand, const uint8_t* is_neg, const uint8_t* op_code,
+    size_t count, uint8_t radix_sel
+){
+    double best = 0.0;
+    unsigned rep = 0;
+    for(; rep < BENCH_REPS; ++rep){
+        double start = now_s();
+        size_t k = 0;
+        for(; k < count; ++k){
+            compute_exp(
+                operand + k * VEC_OPERAND_DIGITS * 2u, is_neg[k], op_code[k],
+                radix_sel
+            );
+        }
+        double took = now_s() - start;
+        if(!rep || took < best) best = took;
+    }
+    return best;
+}
+
+    // Expressions where out disagrees with compute()
+static size_t check(
+    const struct vec_exprs* in, const struct vec_results* out, size_t count,
+    uint8_t radix_sel
+){
+    size_t k = 0, bad = 0;
+    for(; k < count; ++k){
+        const uint8_t* digits = NULL;
+        uint8_t neg = 0, len = 0, n = 0;
+        uint8_t over = compute_exp(
+            in->operand + k * VEC_OPERAND_DIGITS * 2u, in->is_neg[k],
+            in->op_code[k], radix_sel
+        );
+        len = result_digits(&digits, &neg);
+        int same = over == out->error[k];
+        if(same && !over){
+            same = len == out->len[k] && neg == (out->value[k] < 0);
+            for(n = 0; same && n < len; ++n)
+                same = digits[n] == out->digits[n * count + k];
+        }
+        bad += !same;
+    }
+    return bad;
+}
+
+int main(int argc, char* argv[]){
+    size_t count = argc > 1 ? strtoul(argv[1], NULL, 0) : BENCH_COUNT;
+    if(count == 0){
+        fprintf(stderr, "Usage: %s [count]\n", argv[0]);
+        return 1;
+    }
+
+    uint8_t* operand = malloc(count * VEC_OPERAND_DIGITS * 2u);
+    uint8_t* is_neg = malloc(count);
+    uint8_t* op_code = malloc(count);
+    struct vec_results out = {
+        malloc(count * sizeof(int64_t)), malloc(count), malloc(count),
+        malloc(count * VEC_DIGITS)
+    };
+    if(!operand || !is_neg || !op_code
+        || !out.value || !out.error || !out.len || !out.digits
+    ){
+        fprintf(stderr, "%s: out of memory\n", argv[0]);
+        return 2;
+    }
+    struct vec_exprs in = {operand, is_neg, op_code};
+
+    printf("%zu expressions per batch\n", count);
+    printf(
+        "%-6s %-10s %10s %9s %8s\n",
+        "radix", "impl", "Mexpr/s", "speedup", "bad"
+    );
+
+    int failed = 0;
+    uint8_t sel = 0;
+    rng_state = BENCH_SEED;
+    for(; sel < sizeof(radices); ++sel){
+        make_exprs(operand, is_neg, op_code, count, radices[sel]);
+        double base = time_compute(operand, is_neg, op_code, count, sel);
+        printf(
+            "%-6u %-10s %10.1f %8.2fx %8s\n", radices[sel], "compute()",
+            count / base * 1e-6, 1.0, "-"
+        );
+
+        enum vec_impl impl = VEC_SCALAR;
+        for(; impl <= VEC_AVX2; ++impl){
+            if(!vec_supported(impl))    continue;
+            double best = 0.0;
+            unsigned rep = 0;
+            for(; rep < BENCH_REPS; ++rep){
+                double start = now_s();
+                vec_eval(&in, &out, count, radices[sel], impl);
+                double took = now_s() - start;
+                if(!rep || took < best) best = took;
+            }
+            size_t bad = check(&in, &out, count, sel);
+            failed |= bad != 0;
+            printf(
+                "%-6u %-10s %10.1f %8.2fx %8zu\n", radices[sel],
+                vec_impl_name(impl), count / best * 1e-6, base / best, bad
+            );
+        }
+    }
+
+    free(operand);
+    free(is_neg);
+    free(op_code);
+    free(out.value);
+    free(out.error);
+    free(out.len);
+    free(out.digits);
+    return failed;
+}
@@ -0,0 +1,498 @@
+#include "vec_eval.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VEC_X86
+#include <immintrin.h>
+    // Kernels are built for their instruction set whatever the compiler
+    //  flags, and only called once the CPU has been checked.
+#define VEC_SSE41_FN    __attribute__((target("sse4.1")))
+#define VEC_AVX2_FN     __attribute__((target("avx2")))
+#endif
+
+    // Operands have at most four digits in radix 16 or less, so every
+    //  magnitude fits in 16 bits and every result the kernels handle in 32.
+    //  Only a left shift by more than 16 can go wider; those lanes are
+    //  left to the scalar path.
+#define VEC_SHL_NARROW      16u
+
+static uint32_t join(const uint8_t* digits, uint32_t radix){
+    uint32_t value = 0u, n = 0u;
+    for(; n < VEC_OPERAND_DIGITS && digits[n] != VEC_NULL_DIG; ++n)
+        value = value * radix + digits[n];
+    return value;
+}
+
+static void split(
+    uint64_t mag, struct vec_results* out, size_t count, size_t k,
+    uint32_t radix
+){
+    uint8_t len = 0u;
+    for(; mag; ++len){
+        out->digits[len*count + k] = (uint8_t)(mag % radix);
+        mag /= radix;
+    }
+    out->len[k] = len;
+}
+
+    // Expression k on its own, following compute_wide() in main.c.
+static void eval_one(
+    const struct vec_exprs* in, struct vec_results* out, size_t count,
+    size_t k, uint32_t radix
+){
+    const uint8_t* operand = in->operand + k*VEC_OPERAND_DIGITS*2u;
+    uint32_t m1 = join(operand, radix);
+    uint32_t m2 = join(operand + VEC_OPERAND_DIGITS, radix);
+        // A sign on zero is dropped, as compute() negates values
+    int n1 = (in->is_neg[k] & 0x1) && m1, n2 = (in->is_neg[k] & 0x2) && m2;
+    int64_t a = n1 ? -(int64_t)m1 : m1, b = n2 ? -(int64_t)m2 : m2;
+    int64_t res = 0;
+    int err = 0;
+
+    switch(in->op_code[k]){
+        case VEC_ADD:   res = a + b;    break;
+        case VEC_SUB:   res = a - b;    break;
+        case VEC_MUL:   res = a * b;    break;
+        case VEC_DIV:
+            if(m2 == 0u){
+                err = 1;
+                break;
+            }
+            res = m1 / m2;
+            if(n1 != n2)    res = -res;
+            break;
+        case VEC_AND:   res = a & b;    break;
+        case VEC_OR:    res = a | b;    break;
+        case VEC_XOR:   res = a ^ b;    break;
+        case VEC_SHL:
+            if(n2 || m2 > 62u || m1 > (INT64_MAX >> m2)){
+                err = m1 != 0u;
+                break;
+            }
+            res = (int64_t)((uint64_t)m1 << m2);
+            if(n1)  res = -res;
+            break;
+        case VEC_SHR:
+            if(n2 || m2 > 62u)  res = a < 0 ? -1 : 0;
+            else                res = a >> m2;
+            break;
+        default:        res = a;        break;
+    }
+
+    out->error[k] = (uint8_t)err;
+    out->value[k] = err ? 0 : res;
+    split(
+        err ? 0u : res < 0 ? 0u - (uint64_t)res : (uint64_t)res,
+        out, count, k, radix
+    );
+}
+
+#ifdef VEC_X86
+    /**********   Start SSE4.1 kernel   **********/
+    // Four expressions per block. There are no variable shifts before
+    //  AVX2, so shifts go to the scalar path.
+
+VEC_SSE41_FN
+static __m128i join_step4(__m128i v, __m128i* valid, __m128i d, __m128i r){
+    d = _mm_and_si128(d, _mm_set1_epi32(0xFF));
+    *valid = _mm_andnot_si128(
+        _mm_cmpeq_epi32(d, _mm_set1_epi32(VEC_NULL_DIG)), *valid
+    );
+    return _mm_blendv_epi8(
+        v, _mm_add_epi32(_mm_mullo_epi32(v, r), d), *valid
+    );
+}
+
+    // Each 32 bit lane holds one operand's four digit bytes, first digit
+    //  lowest.
+VEC_SSE41_FN
+static __m128i join4(__m128i x, __m128i r){
+    __m128i v = _mm_setzero_si128(), valid = _mm_set1_epi32(-1);
+    v = join_step4(v, &valid, x, r);
+    v = join_step4(v, &valid, _mm_srli_epi32(x, 8), r);
+    v = join_step4(v, &valid, _mm_srli_epi32(x, 16), r);
+    return join_step4(v, &valid, _mm_srli_epi32(x, 24), r);
+}
+
+    // Exact v / 10 for any 32 bit v: (v * 0xCCCCCCCD) >> 35
+VEC_SSE41_FN
+static __m128i div10_4(__m128i v){
+    const __m128i magic = _mm_set1_epi32((int)0xCCCCCCCDu);
+    __m128i even = _mm_srli_epi64(_mm_mul_epu32(v, magic), 35);
+    __m128i odd = _mm_srli_epi64(
+        _mm_mul_epu32(_mm_srli_epi64(v, 32), magic), 35
+    );
+    return _mm_or_si128(even, _mm_slli_epi64(odd, 32));
+}
+
+    // Low byte of each lane, stored as four bytes
+VEC_SSE41_FN
+static void store_row4(__m128i d, uint8_t* dest){
+    const __m128i pick = _mm_setr_epi8(
+        0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+    );
+    int32_t bytes = _mm_cvtsi128_si32(_mm_shuffle_epi8(d, pick));
+    memcpy(dest, &bytes, 4u);
+}
+
+VEC_SSE41_FN
+static void block_sse41(
+    const struct vec_exprs* in, struct vec_results* out, size_t count,
+    size_t k, uint32_t radix, uint32_t shift
+){
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i r = _mm_set1_epi32((int)radix);
+    const uint8_t* operand = in->operand + k*VEC_OPERAND_DIGITS*2u;
+    __m128i a = join4(_mm_loadu_si128((const __m128i*)operand), r);
+    __m128i b = join4(_mm_loadu_si128((const __m128i*)(operand + 16)), r);
+    __m128i m1 = _mm_castps_si128(_mm_shuffle_ps(
+        _mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(2, 0, 2, 0)
+    ));
+    __m128i m2 = _mm_castps_si128(_mm_shuffle_ps(
+        _mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(3, 1, 3, 1)
+    ));
+    int32_t bytes = 0;
+    memcpy(&bytes, in->is_neg + k, 4u);
+    __m128i neg = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(bytes));
+    memcpy(&bytes, in->op_code + k, 4u);
+    __m128i op = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(bytes));
+        // A sign on zero is dropped, as compute() negates values
+    __m128i n1 = _mm_andnot_si128(_mm_cmpeq_epi32(m1, zero), _mm_cmpeq_epi32(
+        _mm_and_si128(neg, _mm_set1_epi32(1)), _mm_set1_epi32(1)
+    ));
+    __m128i n2 = _mm_andnot_si128(_mm_cmpeq_epi32(m2, zero), _mm_cmpeq_epi32(
+        _mm_and_si128(neg, _mm_set1_epi32(2)), _mm_set1_epi32(2)
+    ));
+    __m128i s1 = _mm_sub_epi32(_mm_xor_si128(m1, n1), n1);
+    __m128i s2 = _mm_sub_epi32(_mm_xor_si128(m2, n2), n2);
+
+        // Two's complement operators; anything else gives operand 1
+    __m128i res = s1, is_op = zero;
+    is_op = _mm_cmpeq_epi32(op, _mm_set1_epi32(VEC_ADD));
+    res = _mm_blendv_epi8(res, _mm_add_epi32(s1, s2), is_op);
+    is_op = _mm_cmpeq_epi32(op, _mm_set1_epi32(VEC_SUB));
+    res = _mm_blendv_epi8(res, _mm_sub_epi32(s1, s2), is_op);
+    is_op = _mm_cmpeq_epi32(op, _mm_set1_epi32(VEC_AND));
+    res = _mm_blendv_epi8(res, _mm_and_si128(s1, s2), is_op);
+    is_op = _mm_cmpeq_epi32(op, _mm_set1_epi32(VEC_OR));
+    res = _mm_blendv_epi8(res, _mm_or_si128(s1, s2), is_op);
+    is_op = _mm_cmpeq_epi32(op, _mm_set1_epi32(VEC_XOR));
+    res = _mm_blendv_epi8(res, _mm_xor_si128(s1, s2), is_op);
+    __m128i mag = _mm_abs_epi32(res);
+    __m128i sneg = _mm_cmpgt_epi32(zero, res);
+
+        // Magnitude operators, signed by the operands
+    __m128i nx = _mm_xor_si128(n1, n2), part = zero;
+    is_op = _mm_cmpeq_epi32(op, _mm_set1_epi32(VEC_MUL));
+    part = _mm_mullo_epi32(m1, m2);
+    mag = _mm_blendv_epi8(mag, part, is_op);
+    sneg = _mm_blendv_epi8(
+        sneg, _mm_andnot_si128(_mm_cmpeq_epi32(part, zero), nx), is_op
+    );
+
+        // The float quotient of 16 bit values is off by at most one
+    __m128i by_zero = _mm_cmpeq_epi32(m2, zero);
+    __m128i d = _mm_or_si128(m2, _mm_and_si128(by_zero, _mm_set1_epi32(1)));
+    is_op = _mm_cmpeq_epi32(op, _mm_set1_epi32(VEC_DIV));
+    part = _mm_cvttps_epi32(
+        _mm_div_ps(_mm_cvtepi32_ps(m1), _mm_cvtepi32_ps(d))
+    );
+    __m128i rem = _mm_sub_epi32(m1, _mm_mullo_epi32(part, d));
+    part = _mm_add_epi32(part, _mm_srai_epi32(rem, 31));
+    part = _mm_sub_epi32(part, _mm_cmpgt_epi32(rem, _mm_sub_epi32(d, _mm_set1_epi32(1))));
+    mag = _mm_blendv_epi8(mag, part, is_op);
+    sneg = _mm_blendv_epi8(
+        sneg, _mm_andnot_si128(_mm_cmpeq_epi32(part, zero), nx), is_op
+    );
+    __m128i err = _mm_and_si128(is_op, by_zero);
+
+    __m128i fallback = _mm_or_si128(
+        _mm_cmpeq_epi32(op, _mm_set1_epi32(VEC_SHL)),
+        _mm_cmpeq_epi32(op, _mm_set1_epi32(VEC_SHR))
+    );
+    mag = _mm_andnot_si128(err, mag);
+    sneg = _mm_andnot_si128(err, sneg);
+
+    uint32_t mags[4], negs[4], errs[4];
+    uint8_t lane = 0u;
+    _mm_storeu_si128((__m128i*)mags, mag);
+    _mm_storeu_si128((__m128i*)negs, sneg);
+    _mm_storeu_si128((__m128i*)errs, err);
+    for(; lane < 4u; ++lane){
+        out->error[k+lane] = (uint8_t)(errs[lane] & 0x1);
+        out->value[k+lane] = negs[lane] ? -(int64_t)mags[lane] : mags[lane];
+    }
+
+        // Digits, least significant first, until every lane runs out
+    __m128i len = zero, quot = zero;
+    __m128i cnt = _mm_cvtsi32_si128((int)shift);
+    __m128i low = _mm_set1_epi32((int)radix - 1);
+    uint8_t* row = out->digits + k;
+    for(; !_mm_testz_si128(mag, mag); mag = quot, row += count){
+        len = _mm_sub_epi32(
+            len, _mm_andnot_si128(_mm_cmpeq_epi32(mag, zero), _mm_set1_epi32(-1))
+        );
+        if(shift){
+            quot = _mm_srl_epi32(mag, cnt);
+            store_row4(_mm_and_si128(mag, low), row);
+        } else {
+            quot = div10_4(mag);
+            store_row4(_mm_sub_epi32(mag, _mm_mullo_epi32(quot, r)), row);
+        }
+    }
+    store_row4(len, out->len + k);
+
+    int lanes = _mm_movemask_ps(_mm_castsi128_ps(fallback));
+    for(lane = 0u; lanes; ++lane, lanes >>= 1){
+        if(lanes & 0x1) eval_one(in, out, count, k + lane, radix);
+    }
+}
+    /**********   End SSE4.1 kernel     **********/
+
+    /**********   Start AVX2 kernel   **********/
+    // Eight expressions per block.
+
+VEC_AVX2_FN
+static __m256i join_step8(__m256i v, __m256i* valid, __m256i d, __m256i r){
+    d = _mm256_and_si256(d, _mm256_set1_epi32(0xFF));
+    *valid = _mm256_andnot_si256(
+        _mm256_cmpeq_epi32(d, _mm256_set1_epi32(VEC_NULL_DIG)), *valid
+    );
+    return _mm256_blendv_epi8(
+        v, _mm256_add_epi32(_mm256_mullo_epi32(v, r), d), *valid
+    );
+}
+
+VEC_AVX2_FN
+static __m256i join8(__m256i x, __m256i r){
+    __m256i v = _mm256_setzero_si256(), valid = _mm256_set1_epi32(-1);
+    v = join_step8(v, &valid, x, r);
+    v = join_step8(v, &valid, _mm256_srli_epi32(x, 8), r);
+    v = join_step8(v, &valid, _mm256_srli_epi32(x, 16), r);
+    return join_step8(v, &valid, _mm256_srli_epi32(x, 24), r);
+}
+
+VEC_AVX2_FN
+static __m256i div10_8(__m256i v){
+    const __m256i magic = _mm256_set1_epi32((int)0xCCCCCCCDu);
+    __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(v, magic), 35);
+    __m256i odd = _mm256_srli_epi64(
+        _mm256_mul_epu32(_mm256_srli_epi64(v, 32), magic), 35
+    );
+    return _mm256_or_si256(even, _mm256_slli_epi64(odd, 32));
+}
+
+VEC_AVX2_FN
+static void store_row8(__m256i d, uint8_t* dest){
+    const __m256i pick = _mm256_setr_epi8(
+        0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+    );
+    d = _mm256_permutevar8x32_epi32(
+        _mm256_shuffle_epi8(d, pick), _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0)
+    );
+    _mm_storel_epi64((__m128i*)dest, _mm256_castsi256_si128(d));
+}
+
+VEC_AVX2_FN
+static void block_avx2(
+    const struct vec_exprs* in, struct vec_results* out, size_t count,
+    size_t k, uint32_t radix, uint32_t shift
+){
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i r = _mm256_set1_epi32((int)radix);
+    const uint8_t* operand = in->operand + k*VEC_OPERAND_DIGITS*2u;
+    __m256i a = join8(_mm256_loadu_si256((const __m256i*)operand), r);
+    __m256i b = join8(_mm256_loadu_si256((const __m256i*)(operand + 32)), r);
+        // The shuffle works within 128 bit halves, leaving expressions in
+        //  the order 0 1 4 5 2 3 6 7
+    __m256i m1 = _mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(
+        _mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _MM_SHUFFLE(2, 0, 2, 0)
+    )), _MM_SHUFFLE(3, 1, 2, 0));
+    __m256i m2 = _mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(
+        _mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _MM_SHUFFLE(3, 1, 3, 1)
+    )), _MM_SHUFFLE(3, 1, 2, 0));
+    __m256i neg = _mm256_cvtepu8_epi32(
+        _mm_loadl_epi64((const __m128i*)(in->is_neg + k))
+    );
+    __m256i op = _mm256_cvtepu8_epi32(
+        _mm_loadl_epi64((const __m128i*)(in->op_code + k))
+    );
+        // A sign on zero is dropped, as compute() negates values
+    __m256i n1 = _mm256_andnot_si256(
+        _mm256_cmpeq_epi32(m1, zero), _mm256_cmpeq_epi32(
+            _mm256_and_si256(neg, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)
+        )
+    );
+    __m256i n2 = _mm256_andnot_si256(
+        _mm256_cmpeq_epi32(m2, zero), _mm256_cmpeq_epi32(
+            _mm256_and_si256(neg, _mm256_set1_epi32(2)), _mm256_set1_epi32(2)
+        )
+    );
+    __m256i s1 = _mm256_sub_epi32(_mm256_xor_si256(m1, n1), n1);
+    __m256i s2 = _mm256_sub_epi32(_mm256_xor_si256(m2, n2), n2);
+
+        // Two's complement operators; anything else gives operand 1
+    __m256i res = s1, is_op = zero;
+    is_op = _mm256_cmpeq_epi32(op, _mm256_set1_epi32(VEC_ADD));
+    res = _mm256_blendv_epi8(res, _mm256_add_epi32(s1, s2), is_op);
+    is_op = _mm256_cmpeq_epi32(op, _mm256_set1_epi32(VEC_SUB));
+    res = _mm256_blendv_epi8(res, _mm256_sub_epi32(s1, s2), is_op);
+    is_op = _mm256_cmpeq_epi32(op, _mm256_set1_epi32(VEC_AND));
+    res = _mm256_blendv_epi8(res, _mm256_and_si256(s1, s2), is_op);
+    is_op = _mm256_cmpeq_epi32(op, _mm256_set1_epi32(VEC_OR));
+    res = _mm256_blendv_epi8(res, _mm256_or_si256(s1, s2), is_op);
+    is_op = _mm256_cmpeq_epi32(op, _mm256_set1_epi32(VEC_XOR));
+    res = _mm256_blendv_epi8(res, _mm256_xor_si256(s1, s2), is_op);
+        // Counts past 31 only leave the sign, as does a negative count
+    is_op = _mm256_cmpeq_epi32(op, _mm256_set1_epi32(VEC_SHR));
+    __m256i part = _mm256_or_si256(
+        _mm256_min_epu32(m2, _mm256_set1_epi32(31)),
+        _mm256_and_si256(n2, _mm256_set1_epi32(31))
+    );
+    res = _mm256_blendv_epi8(res, _mm256_srav_epi32(s1, part), is_op);
+    __m256i mag = _mm256_abs_epi32(res);
+    __m256i sneg = _mm256_cmpgt_epi32(zero, res);
+
+        // Magnitude operators, signed by the operands
+    __m256i nx = _mm256_xor_si256(n1, n2);
+    is_op = _mm256_cmpeq_epi32(op, _mm256_set1_epi32(VEC_MUL));
+    part = _mm256_mullo_epi32(m1, m2);
+    mag = _mm256_blendv_epi8(mag, part, is_op);
+    sneg = _mm256_blendv_epi8(
+        sneg, _mm256_andnot_si256(_mm256_cmpeq_epi32(part, zero), nx), is_op
+    );
+
+        // The float quotient of 16 bit values is off by at most one
+    __m256i by_zero = _mm256_cmpeq_epi32(m2, zero);
+    __m256i d = _mm256_or_si256(
+        m2, _mm256_and_si256(by_zero, _mm256_set1_epi32(1))
+    );
+    is_op = _mm256_cmpeq_epi32(op, _mm256_set1_epi32(VEC_DIV));
+    part = _mm256_cvttps_epi32(
+        _mm256_div_ps(_mm256_cvtepi32_ps(m1), _mm256_cvtepi32_ps(d))
+    );
+    __m256i rem = _mm256_sub_epi32(m1, _mm256_mullo_epi32(part, d));
+    part = _mm256_add_epi32(part, _mm256_srai_epi32(rem, 31));
+    part = _mm256_sub_epi32(
+        part, _mm256_cmpgt_epi32(rem, _mm256_sub_epi32(d, _mm256_set1_epi32(1)))
+    );
+    mag = _mm256_blendv_epi8(mag, part, is_op);
+    sneg = _mm256_blendv_epi8(
+        sneg, _mm256_andnot_si256(_mm256_cmpeq_epi32(part, zero), nx), is_op
+    );
+    __m256i err = _mm256_and_si256(is_op, by_zero);
+
+        // A left shift of a non-zero value overloads on a negative count
+        //  or one past 62. Past VEC_SHL_NARROW it may need more than 32
+        //  bits and goes to the scalar path.
+    is_op = _mm256_cmpeq_epi32(op, _mm256_set1_epi32(VEC_SHL));
+    __m256i some = _mm256_xor_si256(
+        _mm256_cmpeq_epi32(m1, zero), _mm256_set1_epi32(-1)
+    );
+    __m256i narrow = _mm256_cmpgt_epi32(
+        _mm256_set1_epi32(VEC_SHL_NARROW + 1), m2
+    );
+    __m256i lost = _mm256_or_si256(
+        n2, _mm256_cmpgt_epi32(m2, _mm256_set1_epi32(62))
+    );
+    part = _mm256_andnot_si256(
+        n2, _mm256_and_si256(_mm256_sllv_epi32(m1, m2), narrow)
+    );
+    mag = _mm256_blendv_epi8(mag, part, is_op);
+    sneg = _mm256_blendv_epi8(
+        sneg, _mm256_andnot_si256(_mm256_cmpeq_epi32(part, zero), n1), is_op
+    );
+    err = _mm256_or_si256(
+        err, _mm256_and_si256(is_op, _mm256_and_si256(lost, some))
+    );
+    __m256i fallback = _mm256_and_si256(
+        is_op, _mm256_andnot_si256(lost, _mm256_andnot_si256(narrow, some))
+    );
+    mag = _mm256_andnot_si256(err, mag);
+    sneg = _mm256_andnot_si256(err, sneg);
+
+    uint32_t mags[8], negs[8], errs[8];
+    uint8_t lane = 0u;
+    _mm256_storeu_si256((__m256i*)mags, mag);
+    _mm256_storeu_si256((__m256i*)negs, sneg);
+    _mm256_storeu_si256((__m256i*)errs, err);
+    for(; lane < 8u; ++lane){
+        out->error[k+lane] = (uint8_t)(errs[lane] & 0x1);
+        out->value[k+lane] = negs[lane] ? -(int64_t)mags[lane] : mags[lane];
+    }
+
+        // Digits, least significant first, until every lane runs out
+    __m256i len = zero, quot = zero;
+    __m128i cnt = _mm_cvtsi32_si128((int)shift);
+    __m256i low = _mm256_set1_epi32((int)radix - 1);
+    uint8_t* row = out->digits + k;
+    for(; !_mm256_testz_si256(mag, mag); mag = quot, row += count){
+        len = _mm256_sub_epi32(
+            len, _mm256_xor_si256(_mm256_cmpeq_epi32(mag, zero), _mm256_set1_epi32(-1))
+        );
+        if(shift){
+            quot = _mm256_srl_epi32(mag, cnt);
+            store_row8(_mm256_and_si256(mag, low), row);
+        } else {
+            quot = div10_8(mag);
+            store_row8(_mm256_sub_epi32(mag, _mm256_mullo_epi32(quot, r)), row);
+        }
+    }
+    store_row8(len, out->len + k);
+
+    int lanes = _mm256_movemask_ps(_mm256_castsi256_ps(fallback));
+    for(lane = 0u; lanes; ++lane, lanes >>= 1){
+        if(lanes & 0x1) eval_one(in, out, count, k + lane, radix);
+    }
+}
+    /**********   End AVX2 kernel     **********/
+#endif
+
+int vec_supported(enum vec_impl impl){
+    switch(impl){
+        case VEC_SCALAR:
+        case VEC_AUTO:      return 1;
+#ifdef VEC_X86
+        case VEC_SSE41:     return __builtin_cpu_supports("sse4.1");
+        case VEC_AVX2:      return __builtin_cpu_supports("avx2");
+#endif
+        default:            return 0;
+    }
+}
+
+const char* vec_impl_name(enum vec_impl impl){
+    switch(impl){
+        case VEC_SCALAR:    return "scalar";
+        case VEC_SSE41:     return "sse4.1";
+        case VEC_AVX2:      return "avx2";
+        default:            return "auto";
+    }
+}
+
+enum vec_impl vec_eval(
+    const struct vec_exprs* in, struct vec_results* out, size_t count,
+    uint8_t radix, enum vec_impl impl
+){
+    uint32_t shift = radix == 2u ? 1u : radix == 8u ? 3u : radix == 16u ? 4u : 0u;
+    size_t k = 0u;
+    if(impl == VEC_AUTO){
+        impl = vec_supported(VEC_AVX2) ? VEC_AVX2
+            : vec_supported(VEC_SSE41) ? VEC_SSE41 : VEC_SCALAR;
+    } else if(!vec_supported(impl)){
+        impl = VEC_SCALAR;
+    }
+
+#ifdef VEC_X86
+    if(impl == VEC_AVX2){
+        for(; k + 8u <= count; k += 8u)
+            block_avx2(in, out, count, k, radix, shift);
+    } else if(impl == VEC_SSE41){
+        for(; k + 4u <= count; k += 4u)
+            block_sse41(in, out, count, k, radix, shift);
+    }
+#endif
+    for(; k < count; ++k)   eval_one(in, out, count, k, radix);
+    return impl;
+}
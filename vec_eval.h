@@ -0,0 +1,70 @@
+#ifndef VEC_EVAL_H
+#define VEC_EVAL_H
+
+    // Host batch evaluation of calculator expressions, for offline
+    //  verification. Gives the same results as compute() in main.c for
+    //  entered expressions (operand 1 not a chained result), many at a
+    //  time, with SSE4.1 and AVX2 kernels picked at run time and a scalar
+    //  fallback.
+    //
+    // Each expression is stored as in expression_data: eight digits, the
+    //  two operands of four each, big endian and left aligned with
+    //  VEC_NULL_DIG filling the empty slots; is_neg bit 0 for operand 1 and
+    //  bit 1 for operand 2; op_code one of the glyphs below. One radix
+    //  applies to the whole batch.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define VEC_NULL_DIG        255u
+#define VEC_OPERAND_DIGITS  4u
+    // Longest result, a shift in binary
+#define VEC_DIGITS          63u
+
+    // Operator glyphs, as in main.c
+#define VEC_ADD             '+'
+#define VEC_SUB             '-'
+#define VEC_MUL             '*'
+#define VEC_DIV             '/'
+#define VEC_AND             '&'
+#define VEC_OR              '|'
+#define VEC_XOR             '^'
+#define VEC_SHL             '<'
+#define VEC_SHR             '>'
+
+enum vec_impl{
+    VEC_SCALAR,
+    VEC_SSE41,
+    VEC_AVX2,
+    VEC_AUTO        // Best the CPU supports
+};
+
+struct vec_exprs{
+    const uint8_t* operand;     // VEC_OPERAND_DIGITS*2 per expression
+    const uint8_t* is_neg;
+    const uint8_t* op_code;
+};
+
+    // Results, as compute() leaves them. On an overload error is set and
+    //  value and len are 0. Digits are least significant first and laid
+    //  out by position so that a kernel stores a whole row at once: digit
+    //  p of expression k is digits[p*count + k]. Rows at or above an
+    //  expression's len are unspecified.
+struct vec_results{
+    int64_t* value;
+    uint8_t* error;
+    uint8_t* len;
+    uint8_t* digits;            // VEC_DIGITS*count
+};
+
+    // Evaluate count expressions in radix 2, 8, 10 or 16. Returns the
+    //  implementation used, which is the scalar one when the requested one
+    //  is not supported.
+enum vec_impl vec_eval(
+    const struct vec_exprs* in, struct vec_results* out, size_t count,
+    uint8_t radix, enum vec_impl impl
+);
+int vec_supported(enum vec_impl impl);
+const char* vec_impl_name(enum vec_impl impl);
+
+#endif